@@ -0,0 +1,280 @@
+/**
+ * @file
+ * Ray throughput and build-time benchmark suite.
+ *
+ * For each scene file given on the command line (mesh URLs are resolved relative to the current directory,
+ * see scripts/run-benchmarks), the benchmark measures scene loading, kD-tree build time, throughput
+ * of primary, diffuse-secondary and occlusion rays, process memory and end-to-end render time.
+ * All random inputs use fixed seeds, every measurement is preceded by warmup runs and repeated,
+ * and the results are printed to stdout as JSON.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "core/parser.h"
+#include "core/perf.h"
+#include "core/random.h"
+#include "core/montecarlo.h"
+#include "geometry/mesh.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gill::core;
+using namespace gill::geometry;
+
+/** Seed of the random number generator used for all generated rays. */
+const unsigned int BenchSeed = 1234;
+
+struct BenchOptions {
+    int warmup = 1;
+    int repeat = 5;
+    int spp = 1;
+    int rays = 1 << 18;
+    bool render = true;
+    bool counters = false;
+    int analyze_rays = 0;
+};
+
+/**
+ * Results of a repeated measurement, in milliseconds.
+ */
+struct Timing {
+    double min, median;
+};
+
+Timing measure(const BenchOptions &options, const char *phase, function<void()> func) {
+    PerfScope scope(phase);
+    for (int i = 0; i < options.warmup; ++i) {
+        func();
+    }
+    vector<double> times;
+    for (int i = 0; i < options.repeat; ++i) {
+        auto begin_time = high_resolution_clock::now();
+        func();
+        duration<double, std::milli> elapsed = high_resolution_clock::now() - begin_time;
+        times.push_back(elapsed.count());
+    }
+    sort(times.begin(), times.end());
+    return { times.front(), times[times.size() / 2] };
+}
+
+/**
+ * Resident set size of the process, in MB.
+ */
+double resident_memory() {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+string timing_json(const Timing &timing) {
+    ostringstream out;
+    out << "{\"min_ms\":" << timing.min << ",\"median_ms\":" << timing.median << "}";
+    return out.str();
+}
+
+string throughput_json(const Timing &timing, size_t count) {
+    ostringstream out;
+    out << "{\"count\":" << count << ",\"min_ms\":" << timing.min << ",\"median_ms\":" << timing.median
+        << ",\"best_mrays_per_s\":" << (count / timing.min * 1e-3)
+        << ",\"median_mrays_per_s\":" << (count / timing.median * 1e-3) << "}";
+    return out.str();
+}
+
+/**
+ * Benchmarks a single scene file.
+ * @returns JSON object with the results.
+ */
+string bench_scene(const char *filename, const BenchOptions &options) {
+    ostringstream json;
+    json << "{\"scene\":\"" << filename << "\"";
+
+    perf_reset();
+    Parser parser;
+    map<string, string> overrides;
+    overrides["spp"] = to_string(options.spp);
+    parser.set_overrides(overrides);
+    double rss_before = resident_memory();
+    auto begin_time = high_resolution_clock::now();
+    parser.open(filename);
+    auto doc = parser.next_document();
+    duration<double, std::milli> load_time = high_resolution_clock::now() - begin_time;
+    if (!doc || !doc->scene || !doc->renderer) {
+        throw std::runtime_error("no scene found");
+    }
+    const Scene *scene = doc->scene.get();
+    json << ",\"faces\":" << scene->total_faces();
+    json << ",\"primitives\":" << scene->primitives().size();
+    json << ",\"load_ms\":" << load_time.count();
+    json << ",\"memory_mb\":" << (resident_memory() - rss_before);
+    MemoryUsage usage;
+    scene->memory_usage(usage);
+    doc->renderer->memory_usage(usage);
+    json << ",\"memory\":" << usage.to_json();
+    if (options.analyze_rays > 0) {
+        json << ",\"accelerators\":" << scene->analyze_accelerators(options.analyze_rays);
+    }
+
+    // Accelerator builds: per-mesh kD-trees and the top-level kD-tree over the primitives
+    set<Mesh *> meshes;
+    for (auto &prim : scene->primitives()) {
+        if (auto mesh = dynamic_pointer_cast<Mesh>(prim.geometry())) {
+            meshes.insert(mesh.get());
+        }
+    }
+    Timing mesh_build = measure(options, "mesh_build", [&meshes]() {
+        for (Mesh *mesh : meshes) {
+            // Rebuilt with the mesh's own (possibly tuned) parameters, so that the rays below use the same tree
+            mesh->build_accelerator(mesh->accelerator()->params());
+        }
+    });
+    Timing scene_build = measure(options, "scene_build", [scene]() {
+        Scene rebuilt(scene->primitives());
+    });
+    json << ",\"mesh_build\":" << timing_json(mesh_build);
+    json << ",\"scene_build\":" << timing_json(scene_build);
+
+    // Ray sets, generated up front with a fixed seed
+    RNG rng(BenchSeed);
+    const Camera *camera = doc->renderer->camera().get();
+    int xres = camera->_film->_xres, yres = camera->_film->_yres;
+    BBox bounds;
+    for (auto &prim : scene->primitives()) {
+        bounds += prim.bounds();
+    }
+    float occlusion_dist = 0.25 * length(bounds.max - bounds.min);
+    vector<Ray> primary, secondary, occlusion;
+    primary.reserve(options.rays);
+    for (int i = 0; i < options.rays; ++i) {
+        Sample sample;
+        sample.image_x = random_float(rng, 0.f, xres);
+        sample.image_y = random_float(rng, 0.f, yres);
+        sample.lens_u = random_float(rng, 0.f, 1.f);
+        sample.lens_v = random_float(rng, 0.f, 1.f);
+        primary.push_back(camera->generate_ray(sample));
+    }
+    for (const Ray &ray : primary) {
+        Intersection isec;
+        float t = Infinity;
+        if (scene->intersect(ray, t, &isec)) {
+            SurfaceInteraction si;
+            scene->compute_surface_interaction(ray, t, isec, si);
+            Vector n = normalize(Vector(si.n));
+            if (dot(n, ray.d) > 0.f) {
+                n = -n;
+            }
+            Vector dir = normalize(n + uniform_sphere_sample(random_float(rng, 0.f, 1.f), random_float(rng, 0.f, 1.f)));
+            Point origin = si.p + n * 1e-3f * occlusion_dist;
+            secondary.push_back(Ray(origin, dir));
+            // Occlusion rays span the parametric range [0,1], ending at a fixed distance from the hit
+            occlusion.push_back(Ray(origin, dir * occlusion_dist));
+        }
+    }
+
+    Timing primary_time = measure(options, "primary_rays", [scene, &primary]() {
+        for (const Ray &ray : primary) {
+            Intersection isec;
+            float t = Infinity;
+            scene->intersect(ray, t, &isec);
+        }
+    });
+    Timing secondary_time = measure(options, "secondary_rays", [scene, &secondary]() {
+        for (const Ray &ray : secondary) {
+            Intersection isec;
+            float t = Infinity;
+            scene->intersect(ray, t, &isec);
+        }
+    });
+    Timing occlusion_time = measure(options, "occlusion_rays", [scene, &occlusion]() {
+        for (const Ray &ray : occlusion) {
+            float t = 1.f;
+            scene->intersect(ray, t, nullptr);
+        }
+    });
+    json << ",\"primary_rays\":" << throughput_json(primary_time, primary.size());
+    json << ",\"secondary_rays\":" << throughput_json(secondary_time, secondary.size());
+    json << ",\"occlusion_rays\":" << throughput_json(occlusion_time, occlusion.size());
+
+    if (options.render) {
+        BenchOptions render_options = options;
+        render_options.warmup = 0;
+        Timing render_time = measure(render_options, "end_to_end", [&doc]() {
+            doc->renderer->render(doc->scene.get());
+        });
+        json << ",\"spp\":" << options.spp;
+        json << ",\"render\":" << timing_json(render_time);
+    }
+    if (options.counters) {
+        json << ",\"counters\":" << perf_report();
+    }
+
+    json << "}";
+    return json.str();
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    vector<const char *> scenes;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            options.repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--spp") == 0 && i + 1 < argc) {
+            options.spp = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc) {
+            options.rays = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-render") == 0) {
+            options.render = false;
+        } else if (strcmp(argv[i], "--analyze") == 0 && i + 1 < argc) {
+            options.analyze_rays = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            options.counters = true;
+            PerfCounters::set_enabled(true);
+        } else {
+            scenes.push_back(argv[i]);
+        }
+    }
+
+    if (scenes.empty()) {
+        cout << "Usage: " << argv[0] << " [--warmup <n>] [--repeat <n>] [--spp <n>] [--rays <n>] [--no-render] [--counters] [--analyze <rays>] <scene_yaml_file>..." << endl;
+        return 0;
+    }
+
+    cout << "{\"warmup\":" << options.warmup << ",\"repeat\":" << options.repeat
+        << ",\"seed\":" << BenchSeed;
+    if (options.counters) {
+        cout << ",\"perf_counters\":" << (PerfCounters::thread_counters().available() ? "true" : "false");
+    }
+    cout << ",\"scenes\":[";
+    for (size_t i = 0; i < scenes.size(); ++i) {
+        if (i > 0) {
+            cout << ",";
+        }
+        try {
+            cout << bench_scene(scenes[i], options);
+        } catch (const exception &e) {
+            cout << "{\"scene\":\"" << scenes[i] << "\",\"error\":\"" << e.what() << "\"}";
+        }
+        cout.flush();
+    }
+    cout << "]}" << endl;
+    return 0;
+}
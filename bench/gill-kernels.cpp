@@ -0,0 +1,340 @@
+/**
+ * @file
+ * Microbenchmarks of the individual ray intersection kernels.
+ *
+ * Each kernel (triangle, bbox, sphere, plane and kD-tree traversal) is tested in isolation
+ * with synthetic ray distributions: hit-heavy rays aimed at the primitive, miss-heavy rays
+ * passing close by, and grazing rays that are (nearly) parallel to the primitive surface.
+ * The benchmark reports time per test and, where hardware counters are available,
+ * branch and cache misses per test, as JSON on stdout.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "core/bbox.h"
+#include "core/montecarlo.h"
+#include "core/perf.h"
+#include "core/random.h"
+#include "geometry/mesh.h"
+#include "geometry/plane.h"
+#include "geometry/sphere.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gill::core;
+using namespace gill::geometry;
+
+/** Seed of the random number generator used for all generated rays and primitives. */
+const unsigned int KernelSeed = 4321;
+
+/** Number of triangles in the triangle kernel pool. */
+const int NumPoolTriangles = 4096;
+
+/** Number of triangles in the kD-tree test mesh. */
+const int NumTreeTriangles = 16384;
+
+struct KernelOptions {
+    int warmup = 2;
+    int repeat = 10;
+    int rays = 1 << 16;
+};
+
+/**
+ * Input of a single kernel benchmark: rays, and for the triangle kernel, index of the tested triangle.
+ */
+struct Workload {
+    vector<Ray> rays;
+    vector<int> indices;
+};
+
+enum Distribution { Hit, Miss, Grazing, NumDistributions };
+const char *DistributionNames[NumDistributions] = { "hit", "miss", "grazing" };
+
+inline float canonical(RNG &rng) {
+    return random_float(rng, 0.f, 1.f);
+}
+
+inline Vector random_direction(RNG &rng) {
+    return uniform_sphere_sample(canonical(rng), canonical(rng));
+}
+
+/**
+ * @returns Random unit vector perpendicular to given direction.
+ */
+inline Vector random_perpendicular(RNG &rng, const Vector &d) {
+    Vector w;
+    do {
+        w = cross(d, random_direction(rng));
+    } while (length(w) < 1e-3f);
+    return normalize(w);
+}
+
+/**
+ * @returns Ray whose line passes at given distance from the origin.
+ */
+Ray ray_at_distance(RNG &rng, float distance, float start) {
+    Vector d = random_direction(rng);
+    Point closest = Point(0.f) + random_perpendicular(rng, d) * distance;
+    return Ray(closest - d * start, d);
+}
+
+Ray ray_towards(const Point &origin, const Point &target) {
+    return Ray(origin, normalize(target - origin));
+}
+
+/**
+ * Runs a kernel over all rays of a workload, repeatedly, and appends the results to JSON output.
+ */
+template<typename Kernel>
+void run(ostream &json, bool &first, const char *name, Distribution dist,
+        const KernelOptions &options, PerfCounters &counters, size_t count, Kernel kernel) {
+    size_t hits = 0;
+    for (int i = 0; i < options.warmup; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            hits += kernel(j);
+        }
+    }
+
+    hits = 0;
+    double best = Infinity;
+    counters.start();
+    for (int i = 0; i < options.repeat; ++i) {
+        auto begin_time = high_resolution_clock::now();
+        for (size_t j = 0; j < count; ++j) {
+            hits += kernel(j);
+        }
+        duration<double, std::nano> elapsed = high_resolution_clock::now() - begin_time;
+        best = std::min(best, elapsed.count());
+    }
+    counters.stop();
+
+    double tests = (double)count * options.repeat;
+    json << (first ? "" : ",") << "{\"kernel\":\"" << name << "\",\"distribution\":\"" << DistributionNames[dist]
+        << "\",\"tests\":" << count << ",\"hit_rate\":" << hits / tests
+        << ",\"ns_per_test\":" << best / count;
+    for (int e = 0; e < NumPerfEvents; ++e) {
+        json << ",\"" << PerfEventNames[e] << "_per_test\":";
+        if (counters.available((PerfEvent)e)) {
+            json << counters.value((PerfEvent)e) / tests;
+        } else {
+            json << "null";
+        }
+    }
+    json << "}";
+    first = false;
+}
+
+/**
+ * Pool of small random triangles, each tested by rays generated specifically for it.
+ */
+shared_ptr<Mesh> triangle_pool(RNG &rng, vector<Point> &vertices) {
+    vector<Mesh::Triangle> triangles;
+    for (int i = 0; i < NumPoolTriangles; ++i) {
+        Point p0(random_float(rng, -1.f, 1.f), random_float(rng, -1.f, 1.f), random_float(rng, -1.f, 1.f));
+        int index = vertices.size();
+        vertices.push_back(p0);
+        vertices.push_back(p0 + random_direction(rng) * 0.1f);
+        vertices.push_back(p0 + random_direction(rng) * 0.1f);
+        triangles.push_back({ index, index + 1, index + 2 });
+    }
+    return Mesh::from_triangles(vertices, triangles);
+}
+
+Workload triangle_workload(RNG &rng, const vector<Point> &vertices, Distribution dist, int count) {
+    Workload workload;
+    for (int i = 0; i < count; ++i) {
+        int index = random_int(rng, 0, NumPoolTriangles - 1);
+        const Point &p0 = vertices[3 * index], &p1 = vertices[3 * index + 1], &p2 = vertices[3 * index + 2];
+        Vector e1 = p1 - p0, e2 = p2 - p0;
+        Vector n = normalize(cross(e1, e2));
+        float u = canonical(rng), v = canonical(rng);
+        if (u + v > 1.f) {
+            u = 1.f - u;
+            v = 1.f - v;
+        }
+        if (dist == Miss) {
+            // Reflect the barycentric coordinates outside of the triangle
+            u = -u - 0.05f;
+        }
+        Point target = p0 + e1 * u + e2 * v;
+        Ray ray;
+        if (dist == Grazing) {
+            Vector d = normalize(random_perpendicular(rng, n) + n * random_float(rng, -1e-3f, 1e-3f));
+            ray = Ray(target - d, d);
+        } else {
+            ray = ray_towards(target + random_direction(rng), target);
+        }
+        workload.rays.push_back(ray);
+        workload.indices.push_back(index);
+    }
+    return workload;
+}
+
+Workload bbox_workload(RNG &rng, Distribution dist, int count) {
+    Workload workload;
+    for (int i = 0; i < count; ++i) {
+        if (dist == Hit) {
+            Point target(random_float(rng, -0.9f, 0.9f), random_float(rng, -0.9f, 0.9f), random_float(rng, -0.9f, 0.9f));
+            workload.rays.push_back(ray_towards(Point(0.f) + random_direction(rng) * 4.f, target));
+        } else if (dist == Miss) {
+            // Lines further than sqrt(3) from the center never touch the box
+            workload.rays.push_back(ray_at_distance(rng, random_float(rng, 1.8f, 3.f), 4.f));
+        } else {
+            // Rays running along the Y+ face, half of them exactly parallel to it
+            float dy = (i % 2) ? 0.f : random_float(rng, -1e-3f, 1e-3f);
+            Vector d = normalize(Vector(1.f, dy, random_float(rng, -0.1f, 0.1f)));
+            Point o(-4.f, 1.f + random_float(rng, -1e-4f, 1e-4f), random_float(rng, -0.9f, 0.9f));
+            workload.rays.push_back(Ray(o, d));
+        }
+    }
+    return workload;
+}
+
+Workload sphere_workload(RNG &rng, Distribution dist, int count) {
+    Workload workload;
+    for (int i = 0; i < count; ++i) {
+        if (dist == Hit) {
+            Point target = Point(0.f) + random_direction(rng) * (0.9f * cbrt(canonical(rng)));
+            workload.rays.push_back(ray_towards(Point(0.f) + random_direction(rng) * 3.f, target));
+        } else if (dist == Miss) {
+            workload.rays.push_back(ray_at_distance(rng, random_float(rng, 1.1f, 2.f), 3.f));
+        } else {
+            workload.rays.push_back(ray_at_distance(rng, random_float(rng, 0.999f, 1.001f), 3.f));
+        }
+    }
+    return workload;
+}
+
+Workload plane_workload(RNG &rng, Distribution dist, int count) {
+    Workload workload;
+    for (int i = 0; i < count; ++i) {
+        Point target(random_float(rng, -0.5f, 0.5f), random_float(rng, -0.5f, 0.5f), 0.f);
+        if (dist == Miss) {
+            while (abs(target.x) <= 0.5f && abs(target.y) <= 0.5f) {
+                target = Point(random_float(rng, -2.f, 2.f), random_float(rng, -2.f, 2.f), 0.f);
+            }
+        }
+        if (dist == Grazing) {
+            float phi = random_float(rng, 0.f, 2.f * Pi);
+            Vector d = normalize(Vector(cos(phi), sin(phi), random_float(rng, -1e-3f, 1e-3f)));
+            workload.rays.push_back(Ray(target - d * 2.f, d));
+        } else {
+            Vector offset = uniform_hemisphere_sample(random_float(rng, 0.05f, 1.f), canonical(rng));
+            workload.rays.push_back(ray_towards(target + offset * 2.f, target));
+        }
+    }
+    return workload;
+}
+
+/**
+ * Mesh of small random triangles scattered over the unit sphere, so that rays can hit it,
+ * traverse its (partially empty) kD-tree without hitting anything, or graze its surface.
+ */
+shared_ptr<Mesh> tree_mesh(RNG &rng) {
+    vector<Point> vertices;
+    vector<Mesh::Triangle> triangles;
+    for (int i = 0; i < NumTreeTriangles; ++i) {
+        Vector c = random_direction(rng);
+        Vector t1 = random_perpendicular(rng, c), t2 = cross(c, t1);
+        int index = vertices.size();
+        for (int j = 0; j < 3; ++j) {
+            float phi = random_float(rng, 0.f, 2.f * Pi);
+            vertices.push_back(Point(0.f) + c + (t1 * cos(phi) + t2 * sin(phi)) * 0.05f);
+        }
+        triangles.push_back({ index, index + 1, index + 2 });
+    }
+    return Mesh::from_triangles(vertices, triangles);
+}
+
+Workload tree_workload(RNG &rng, Distribution dist, int count) {
+    Workload workload;
+    for (int i = 0; i < count; ++i) {
+        if (dist == Hit) {
+            Point target = Point(0.f) + random_direction(rng) * (0.5f * canonical(rng));
+            workload.rays.push_back(ray_towards(Point(0.f) + random_direction(rng) * 3.f, target));
+        } else if (dist == Miss) {
+            // Passing through the corners of the mesh bounds, outside of the sphere
+            workload.rays.push_back(ray_at_distance(rng, random_float(rng, 1.1f, 1.6f), 3.f));
+        } else {
+            workload.rays.push_back(ray_at_distance(rng, random_float(rng, 0.97f, 1.f), 3.f));
+        }
+    }
+    return workload;
+}
+
+int main(int argc, char *argv[]) {
+    KernelOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            options.repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc) {
+            options.rays = std::max(1, atoi(argv[++i]));
+        } else {
+            cout << "Usage: " << argv[0] << " [--warmup <n>] [--repeat <n>] [--rays <n>]" << endl;
+            return 0;
+        }
+    }
+
+    RNG rng(KernelSeed);
+    PerfCounters counters;
+    vector<Point> pool_vertices;
+    auto pool = triangle_pool(rng, pool_vertices);
+    auto tree = tree_mesh(rng);
+    BBox box(Point(-1.f), Point(1.f));
+    Sphere sphere(1.f);
+    Plane plane;
+
+    ostringstream json;
+    bool first = true;
+    json << "{\"warmup\":" << options.warmup << ",\"repeat\":" << options.repeat << ",\"seed\":" << KernelSeed
+        << ",\"perf_counters\":" << (counters.available() ? "true" : "false") << ",\"kernels\":[";
+    for (int d = 0; d < NumDistributions; ++d) {
+        Distribution dist = (Distribution)d;
+
+        Workload tri = triangle_workload(rng, pool_vertices, dist, options.rays);
+        Mesh *pool_ptr = pool.get();
+        const vector<Mesh::Triangle> &pool_triangles = pool->triangles();
+        run(json, first, "triangle", dist, options, counters, tri.rays.size(), [&](size_t i) {
+            float t = Infinity;
+            return pool_triangles[tri.indices[i]].intersect(pool_ptr, tri.rays[i], t, nullptr);
+        });
+
+        Workload bbox = bbox_workload(rng, dist, options.rays);
+        run(json, first, "bbox", dist, options, counters, bbox.rays.size(), [&](size_t i) {
+            float tmin, tmax;
+            return box.intersects(bbox.rays[i], tmin, tmax);
+        });
+
+        Workload sph = sphere_workload(rng, dist, options.rays);
+        run(json, first, "sphere", dist, options, counters, sph.rays.size(), [&](size_t i) {
+            float t = Infinity;
+            return sphere.intersect(sph.rays[i], t, nullptr);
+        });
+
+        Workload pln = plane_workload(rng, dist, options.rays);
+        run(json, first, "plane", dist, options, counters, pln.rays.size(), [&](size_t i) {
+            float t = Infinity;
+            return plane.intersect(pln.rays[i], t, nullptr);
+        });
+
+        Workload kd = tree_workload(rng, dist, options.rays);
+        run(json, first, "kdtree", dist, options, counters, kd.rays.size(), [&](size_t i) {
+            float t = Infinity;
+            Intersection isec;
+            return tree->intersect(kd.rays[i], t, &isec);
+        });
+    }
+    json << "]}";
+    cout << json.str() << endl;
+    return 0;
+}
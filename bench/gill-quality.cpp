@@ -0,0 +1,288 @@
+/**
+ * @file
+ * Equal-time quality benchmark.
+ *
+ * For each scene file given on the command line, the benchmark renders the scene at increasing
+ * sample counts, and compares each image against a high-spp reference (rendered once and stored
+ * as a PFM file in the reference directory) using RMSE and relative MSE. The results, including
+ * the efficiency (inverse of relMSE times render time), are printed as JSON on stdout, and optionally
+ * plotted as error vs. render time into an SVG file, so that samplers, integrators and accelerators
+ * can be compared on error at equal time rather than on speed alone.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cerrno>
+#include <sys/stat.h>
+
+#include "core/parser.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace gill::core;
+
+/** Offset of the denominator in relative MSE, avoiding division by zero in dark pixels. */
+const float RelMSEEpsilon = 0.01f;
+/** Number of color channels compared. */
+const int Channels = 3;
+
+struct QualityOptions {
+    int reference_spp = 256;
+    int max_spp = 64;
+    string reference_dir = "references";
+    const char *plot = nullptr;
+};
+
+/**
+ * Unclamped RGB image, stored bottom-to-top like gill::core::Film.
+ */
+struct Image {
+    int width = 0, height = 0;
+    vector<float> data;
+};
+
+/**
+ * Result of rendering a scene at one sample count.
+ */
+struct Level {
+    int spp;
+    double time_ms;
+    double rmse, relmse;
+};
+
+Image film_image(const Film &film) {
+    Image image;
+    image.width = film._xres;
+    image.height = film._yres;
+    for (int y = 0; y < film._yres; ++y) {
+        for (int x = 0; x < film._xres; ++x) {
+            RGB radiance = film.get_radiance(x, y);
+            for (int c = 0; c < Channels; ++c) {
+                image.data.push_back(radiance[c]);
+            }
+        }
+    }
+    return image;
+}
+
+/**
+ * Reads an image in the (little-endian, RGB) Portable Float Map format.
+ * @returns False if the file does not exist or is not a supported PFM.
+ */
+bool read_pfm(const string &filename, Image &image) {
+    ifstream in(filename, ios::binary);
+    string magic;
+    float scale;
+    if (!(in >> magic >> image.width >> image.height >> scale) || magic != "PF" || scale >= 0.f) {
+        return false;
+    }
+    in.get();
+    image.data.resize(image.width * image.height * Channels);
+    in.read((char *)&image.data[0], image.data.size() * sizeof(float));
+    return (bool)in;
+}
+
+void write_pfm(const string &filename, const Image &image) {
+    ofstream out(filename, ios::binary);
+    if (!out) {
+        throw std::runtime_error("cannot write reference file " + filename);
+    }
+    out << "PF\n" << image.width << " " << image.height << "\n-1.0\n";
+    out.write((const char *)&image.data[0], image.data.size() * sizeof(float));
+}
+
+/**
+ * Creates a directory unless it exists (its parent must exist).
+ * @returns False if the directory could not be created, or the path is not a directory.
+ */
+bool make_directory(const string &path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+        return S_ISDIR(info.st_mode);
+    }
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+/**
+ * Renders the first document of a scene file with given sample count.
+ * @returns Rendered image; 'time_ms' receives the render time (without parsing).
+ */
+Image render(Parser &parser, const char *filename, int spp, double &time_ms) {
+    map<string, string> overrides;
+    overrides["spp"] = to_string(spp);
+    parser.set_overrides(overrides);
+    parser.open(filename);
+    auto doc = parser.next_document();
+    if (!doc || !doc->scene || !doc->renderer) {
+        throw std::runtime_error("no scene found");
+    }
+    auto begin_time = high_resolution_clock::now();
+    doc->renderer->render(doc->scene.get());
+    duration<double, std::milli> elapsed = high_resolution_clock::now() - begin_time;
+    time_ms = elapsed.count();
+    return film_image(*doc->renderer->camera()->_film);
+}
+
+void compare(const Image &image, const Image &reference, Level &level) {
+    if (image.width != reference.width || image.height != reference.height) {
+        throw std::runtime_error("reference resolution does not match");
+    }
+    double se = 0.0, rel_se = 0.0;
+    for (size_t i = 0; i < image.data.size(); ++i) {
+        double diff = image.data[i] - reference.data[i];
+        se += diff * diff;
+        rel_se += diff * diff / (reference.data[i] * reference.data[i] + RelMSEEpsilon);
+    }
+    level.rmse = sqrt(se / image.data.size());
+    level.relmse = rel_se / image.data.size();
+}
+
+string scene_name(const char *filename) {
+    string name(filename);
+    size_t slash = name.find_last_of('/');
+    if (slash != string::npos) {
+        name = name.substr(slash + 1);
+    }
+    size_t dot = name.find_last_of('.');
+    return dot == string::npos ? name : name.substr(0, dot);
+}
+
+/**
+ * Plots relMSE against render time (both on log scales) for all scenes into an SVG file.
+ */
+void write_plot(const char *filename, const vector<string> &names, const vector<vector<Level>> &results) {
+    const int width = 640, height = 480, margin = 60;
+    const char *colors[] = { "#1f77b4", "#ff7f0e", "#2ca02c", "#d62728", "#9467bd", "#8c564b" };
+    double tmin = Infinity, tmax = -Infinity, emin = Infinity, emax = -Infinity;
+    for (auto &levels : results) {
+        for (auto &level : levels) {
+            tmin = std::min(tmin, log10(level.time_ms));
+            tmax = std::max(tmax, log10(level.time_ms));
+            emin = std::min(emin, log10(level.relmse));
+            emax = std::max(emax, log10(level.relmse));
+        }
+    }
+    tmin = floor(tmin); tmax = std::max(ceil(tmax), tmin + 1);
+    emin = floor(emin); emax = std::max(ceil(emax), emin + 1);
+    auto px = [&](double t) { return margin + (log10(t) - tmin) / (tmax - tmin) * (width - 2 * margin); };
+    auto py = [&](double e) { return height - margin - (log10(e) - emin) / (emax - emin) * (height - 2 * margin); };
+
+    ofstream out(filename);
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width << "\" height=\"" << height << "\""
+        << " font-family=\"sans-serif\" font-size=\"12\">\n";
+    out << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+    out << "<rect x=\"" << margin << "\" y=\"" << margin << "\" width=\"" << width - 2 * margin
+        << "\" height=\"" << height - 2 * margin << "\" fill=\"none\" stroke=\"black\"/>\n";
+    for (int t = (int)tmin; t <= (int)tmax; ++t) {
+        double x = px(pow(10.0, t));
+        out << "<text x=\"" << x << "\" y=\"" << height - margin + 16 << "\" text-anchor=\"middle\">1e" << t << "</text>\n";
+    }
+    for (int e = (int)emin; e <= (int)emax; ++e) {
+        double y = py(pow(10.0, e));
+        out << "<text x=\"" << margin - 6 << "\" y=\"" << y + 4 << "\" text-anchor=\"end\">1e" << e << "</text>\n";
+    }
+    out << "<text x=\"" << width / 2 << "\" y=\"" << height - 16 << "\" text-anchor=\"middle\">render time (ms)</text>\n";
+    out << "<text x=\"16\" y=\"" << height / 2 << "\" text-anchor=\"middle\" transform=\"rotate(-90 16 "
+        << height / 2 << ")\">relMSE</text>\n";
+    for (size_t s = 0; s < results.size(); ++s) {
+        const char *color = colors[s % 6];
+        out << "<polyline fill=\"none\" stroke=\"" << color << "\" points=\"";
+        for (auto &level : results[s]) {
+            out << px(level.time_ms) << "," << py(level.relmse) << " ";
+        }
+        out << "\"/>\n";
+        for (auto &level : results[s]) {
+            out << "<circle cx=\"" << px(level.time_ms) << "\" cy=\"" << py(level.relmse) << "\" r=\"3\" fill=\"" << color << "\"/>\n";
+        }
+        out << "<text x=\"" << width - margin - 4 << "\" y=\"" << margin + 16 * (s + 1) << "\" text-anchor=\"end\" fill=\""
+            << color << "\">" << names[s] << "</text>\n";
+    }
+    out << "</svg>\n";
+}
+
+int main(int argc, char *argv[]) {
+    QualityOptions options;
+    vector<const char *> scenes;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--reference-spp") == 0 && i + 1 < argc) {
+            options.reference_spp = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--max-spp") == 0 && i + 1 < argc) {
+            options.max_spp = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--references") == 0 && i + 1 < argc) {
+            options.reference_dir = argv[++i];
+        } else if (strcmp(argv[i], "--plot") == 0 && i + 1 < argc) {
+            options.plot = argv[++i];
+        } else {
+            scenes.push_back(argv[i]);
+        }
+    }
+
+    if (scenes.empty()) {
+        cout << "Usage: " << argv[0] << " [--reference-spp <n>] [--max-spp <n>] [--references <dir>] [--plot <svg_file>]"
+            << " <scene_yaml_file>..." << endl;
+        return 0;
+    }
+
+    // References are generated on the first run, e.g. from a fresh checkout
+    if (!make_directory(options.reference_dir)) {
+        cerr << "cannot create reference directory " << options.reference_dir << endl;
+        return 1;
+    }
+
+    vector<string> names;
+    vector<vector<Level>> results;
+    cout << "{\"reference_spp\":" << options.reference_spp << ",\"scenes\":[";
+    for (size_t i = 0; i < scenes.size(); ++i) {
+        string name = scene_name(scenes[i]);
+        cout << (i > 0 ? "," : "") << "{\"scene\":\"" << scenes[i] << "\"";
+        try {
+            Parser parser;
+            Image reference;
+            string reference_file = options.reference_dir + "/" + name + ".pfm";
+            if (!read_pfm(reference_file, reference)) {
+                double time_ms;
+                reference = render(parser, scenes[i], options.reference_spp, time_ms);
+                write_pfm(reference_file, reference);
+            }
+
+            vector<Level> levels;
+            for (int spp = 1; spp <= options.max_spp; spp *= 2) {
+                Level level;
+                level.spp = spp;
+                Image image = render(parser, scenes[i], spp, level.time_ms);
+                compare(image, reference, level);
+                levels.push_back(level);
+            }
+
+            cout << ",\"reference\":\"" << reference_file << "\",\"levels\":[";
+            for (size_t j = 0; j < levels.size(); ++j) {
+                const Level &level = levels[j];
+                cout << (j > 0 ? "," : "") << "{\"spp\":" << level.spp << ",\"time_ms\":" << level.time_ms
+                    << ",\"rmse\":" << level.rmse << ",\"relmse\":" << level.relmse
+                    << ",\"efficiency\":" << 1.0 / (level.relmse * level.time_ms * 1e-3) << "}";
+            }
+            cout << "]}";
+            names.push_back(name);
+            results.push_back(levels);
+        } catch (const exception &e) {
+            cout << ",\"error\":\"" << e.what() << "\"}";
+        }
+        cout.flush();
+    }
+    cout << "]}" << endl;
+
+    if (options.plot && !results.empty()) {
+        write_plot(options.plot, names, results);
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <future>
+#include <iostream>
+
+#include "core/batch.h"
+#include "core/perf.h"
+#include "core/trace.h"
+
+namespace gill { namespace core {
+
+using namespace std;
+
+/** Estimated memory per scene face (geometry and accelerator), in bytes. */
+const size_t BytesPerFace = 64;
+
+float estimated_size(const Parser::Document &doc) {
+    auto film = doc.renderer->camera()->_film;
+    size_t bytes = doc.scene->total_faces() * BytesPerFace + film->_xres * film->_yres * sizeof(Film::Pixel);
+    return bytes / (1024.0 * 1024.0);
+}
+
+/**
+ * Prints hardware counters of all phases since the last report (if enabled) to stderr.
+ */
+static void report_counters() {
+    if (PerfCounters::enabled()) {
+        cerr << "counters:" << perf_report() << endl;
+        perf_reset();
+    }
+}
+
+/**
+ * Writes the outputs of a document within the "output" phase.
+ */
+static void write_outputs(const Parser::Document &doc, const DocumentWriter &write) {
+    PerfScope scope("output");
+    TraceScope trace("output", "output");
+    write(doc);
+}
+
+void render_sequential(Parser &parser, bool heatmap, const DocumentWriter &write) {
+    while (auto doc = parser.next_document()) {
+        if (heatmap) {
+            doc->renderer->camera()->_film->enable_heatmap();
+        }
+        doc->renderer->render(doc->scene.get());
+        write_outputs(*doc, write);
+        report_counters();
+    }
+}
+
+void render_pipelined(Parser &parser, float budget, bool heatmap, const DocumentWriter &write) {
+    auto parse = [&parser]() { return parser.next_document(); };
+    future<shared_ptr<Parser::Document>> next = async(launch::async, parse);
+    future<void> output;
+    while (auto doc = next.get()) {
+        bool prefetch = 2.0 * estimated_size(*doc) <= budget;
+        // Deferred futures are evaluated synchronously when the document is requested
+        next = async(prefetch ? launch::async : launch::deferred, parse);
+        if (heatmap) {
+            doc->renderer->camera()->_film->enable_heatmap();
+        }
+        doc->renderer->render(doc->scene.get());
+        if (output.valid()) {
+            output.wait();
+        }
+        output = async(launch::async, [doc, &write]() { write_outputs(*doc, write); });
+    }
+    if (output.valid()) {
+        output.wait();
+    }
+    // Phases of consecutive documents overlap, so only the totals are reported
+    report_counters();
+}
+
+}}
@@ -0,0 +1,41 @@
+#ifndef GILL_CORE_BATCH_H_
+#define GILL_CORE_BATCH_H_
+
+#include <functional>
+
+#include "core/parser.h"
+
+namespace gill { namespace core {
+
+/**
+ * Writes the outputs (image, heatmap, ...) of a rendered document.
+ */
+typedef std::function<void(const Parser::Document &doc)> DocumentWriter;
+
+/**
+ * Rough estimate of the memory held by a parsed document (scene geometry and film), in MB.
+ */
+float estimated_size(const Parser::Document &doc);
+
+/**
+ * Renders all documents one after another.
+ * @param parser Parser of the input documents.
+ * @param heatmap Whether to record the traversal-cost heatmaps of the documents.
+ * @param write Writes the outputs of each document after it has been rendered.
+ */
+void render_sequential(Parser &parser, bool heatmap, const DocumentWriter &write);
+
+/**
+ * Renders all documents, preparing document N+1 on a background thread while document N renders,
+ * and writing the outputs of document N-1 asynchronously.
+ * @param parser Parser of the input documents.
+ * @param budget Memory budget (in MB). The next document is only prepared in the background
+ * if twice the size of the current one (assuming the next document is of similar size) fits the budget.
+ * @param heatmap Whether to record the traversal-cost heatmaps of the documents.
+ * @param write Writes the outputs of each document, in the order of the documents (on another thread).
+ */
+void render_pipelined(Parser &parser, float budget, bool heatmap, const DocumentWriter &write);
+
+}}
+
+#endif
@@ -1,13 +1,27 @@
+#include <stdexcept>
+
 #include "core/bsdf.h"
+#include "core/montecarlo.h"
 
 namespace gill { namespace core {
 
 using namespace std;
 
+// ShadingFrame methods
+
+ShadingFrame::ShadingFrame(const Normal &normal) : n(normalize(Vector(normal))) {
+    if (std::abs(n.x) > std::abs(n.y)) {
+        s = Vector(-n.z, 0.f, n.x) / std::sqrt(n.x * n.x + n.z * n.z);
+    } else {
+        s = Vector(0.f, n.z, -n.y) / std::sqrt(n.y * n.y + n.z * n.z);
+    }
+    t = cross(n, s);
+}
+
 // BxDF methods
 
 Spectrum BxDF::sample(const Vector &wo, Vector &wi, float u1, float u2, float *_pdf) const {
-    wi = normalize(Vector(u1, u2, 1.f)); // should use Monte Carlo eventually
+    wi = cosine_hemisphere_sample(u1, u2);
     if (wo.z < 0.f) {
         wi.z *= -1.f;
     }
@@ -53,6 +67,10 @@ Spectrum ScaledBxDF::sample(const Vector &wo, Vector &wi, float u1, float u2, fl
     return _scale * f;
 }
 
+float ScaledBxDF::pdf(const Vector &wo, const Vector &wi) const {
+    return _bxdf->pdf(wo, wi);
+}
+
 // SpecularReflection methods
 
 SpecularReflection::SpecularReflection(Fresnel *fresnel, const Spectrum &r)
@@ -119,18 +137,63 @@ Spectrum LambertianReflection::evaluate(const Vector &wo, const Vector &wi) cons
 
 // BSDF methods
 
-Spectrum BSDF::evaluate(const Vector &wi, const Vector &wo) const {
-    return Spectrum();
+Spectrum BSDF::evaluate(const Vector &wo, const Vector &wi) const {
+    BxDF::Type side = same_hemisphere(wo, wi) ? BxDF::Type::Reflection : BxDF::Type::Transmission;
+    Spectrum f(0.f);
+    for (int i = 0; i < _count; ++i) {
+        const BxDF *bxdf = _bxdfs[i];
+        if (bxdf->has_type(side) && !bxdf->has_type(BxDF::Type::Specular)) {
+            f += bxdf->evaluate(wo, wi);
+        }
+    }
+    return f;
 }
 
-void BSDF::add(BxDF * bxdf) {
-    _bxdfs.push_back(bxdf);
+Spectrum BSDF::sample(const Vector &wo, Vector &wi, float u1, float u2, float u3, float *_pdf,
+        BxDF::Type *sampled_type) const {
+    int count = num_components();
+    *_pdf = 0.f;
+    if (count == 0) {
+        return Spectrum(0.f);
+    }
+    BxDF *bxdf = _bxdfs[std::min((int)(u3 * count), count - 1)];
+    Spectrum f = bxdf->sample(wo, wi, u1, u2, _pdf);
+    if (*_pdf == 0.f) {
+        return Spectrum(0.f);
+    }
+    if (sampled_type) {
+        *sampled_type = bxdf->type;
+    }
+    if (bxdf->has_type(BxDF::Type::Specular)) {
+        *_pdf /= count;
+        return f;
+    }
+    // Non-specular directions could have been sampled by any of the non-specular functions
+    if (count > 1) {
+        *_pdf = pdf(wo, wi);
+        f = evaluate(wo, wi);
+    }
+    return f;
 }
 
-BSDF::~BSDF() {
-    for (auto bxdf : _bxdfs) {
-        delete bxdf;
+float BSDF::pdf(const Vector &wo, const Vector &wi) const {
+    if (_count == 0) {
+        return 0.f;
+    }
+    float sum = 0.f;
+    for (int i = 0; i < _count; ++i) {
+        if (!_bxdfs[i]->has_type(BxDF::Type::Specular)) {
+            sum += _bxdfs[i]->pdf(wo, wi);
+        }
+    }
+    return sum / _count;
+}
+
+void BSDF::add(BxDF * bxdf) {
+    if (_count == MaxBxDFs) {
+        throw std::runtime_error("too many BxDFs in a BSDF");
     }
+    _bxdfs[_count++] = bxdf;
 }
 
 }}
@@ -10,7 +10,7 @@ namespace gill { namespace core {
 
 // Helpers for spherical coordinates (theta and phi angles) of vectors in the shading coordinate system.
 inline float cos_theta(const Vector &w) { return w.z; }
-inline float abs_cos_theta(const Vector &w) { return std::abs(cos_theta(w.z)); }
+inline float abs_cos_theta(const Vector &w) { return std::abs(w.z); }
 inline float squared_sin_theta(const Vector &w) { return std::max(0.f, 1.f - cos_theta(w) * cos_theta(w)); }
 inline float sin_theta(const Vector &w) { return std::sqrt(squared_sin_theta(w)); }
 inline float cos_phi(const Vector &w) {
@@ -25,6 +25,18 @@ inline bool same_hemisphere(const Vector &w, const Vector &wp) { return w.z * wp
 inline Vector swap_z(const Vector &v) { return Vector(v.x, v.y, -v.z); }
 
 
+/**
+ * Orthonormal shading coordinate system of a surface point, with the surface normal along the Z axis.
+ */
+struct ShadingFrame {
+    Vector s, t, n;
+
+    ShadingFrame(const Normal &normal);
+    Vector to_local(const Vector &v) const { return Vector(dot(v, s), dot(v, t), dot(v, n)); }
+    Vector to_world(const Vector &v) const { return s * v.x + t * v.y + n * v.z; }
+};
+
+
 /**
  * Abstraction of either a bidirectional reflectance or a bidirectional transmittance distribution function.
  * @note By convention, incident (wi) and outgoing (wo) vectors are assumed to be normalized and outward facing.
@@ -48,6 +60,9 @@ public:
     BxDF(Type t) : type(t) {}
     virtual ~BxDF() {}
 
+    /** Checks whether the function has all of the given type flags. */
+    bool has_type(Type flags) const { return (static_cast<int>(type) & static_cast<int>(flags)) == static_cast<int>(flags); }
+
     /**
      * Evaluate reflectance or transmittance for given incident and outgoing light direction.
      * @param wo Outgoing light direction.
@@ -60,9 +75,13 @@ public:
     /**
      * Sample reflectance or transmittance; similar to BxDF::evaluate but used for
      * delta distributions and randomly sampled directions.
+     * By default, directions are sampled from the cosine-weighted hemisphere of 'wo'.
      * @param wo Outgoing light direction.
-     * @param wi Incident light direction.
-     * @note u1, u2 and pdf will be used for Monte Carlo integration.
+     * @param wi Incident light direction, chosen by the function.
+     * @param u1 Random value, uniformly sampled from [0,1) interval.
+     * @param u2 Random value, uniformly sampled from [0,1) interval.
+     * @param pdf Probability density of the chosen direction (1 for delta distributions).
+     * @returns Reflectance or transmittance spectrum for the chosen direction.
      */
     virtual Spectrum sample(const Vector &wo, Vector &wi, float u1, float u2, float *pdf) const;
 
@@ -79,6 +98,9 @@ public:
      */
     //virtual Spectrum rho(int num_samples, const float *samples1, const float *samples2) const;
 
+    /**
+     * Probability density of BxDF::sample choosing 'wi' for given 'wo'.
+     */
     virtual float pdf(const Vector &wo, const Vector &wi) const;
 };
 
@@ -110,6 +132,7 @@ public:
     ScaledBxDF(BxDF *bxdf, const Spectrum &scale);
     Spectrum evaluate(const Vector &wo, const Vector &wi) const override;
     Spectrum sample(const Vector &wo, Vector &wi, float u1, float u2, float *pdf) const override;
+    float pdf(const Vector &wo, const Vector &wi) const override;
 
 protected:
     BxDF *_bxdf;
@@ -165,22 +188,49 @@ protected:
 /**
  * Bidirectional scattering distribution function,
  * defined by one or more gill::core::BxDF functions.
+ * @note BSDFs and their functions are created per intersection in a gill::core::MemoryArena,
+ * so the BSDF does not own (and never deletes) its functions.
  */
 class BSDF {
 public:
     /**
-     * Reflectance or transmittance for given pair of vectors.
-     * @param wi Incident light direction.
+     * Reflectance or transmittance for given pair of vectors, summed over all non-specular functions.
      * @param wo Outgoing light direction.
+     * @param wi Incident light direction.
      * @returns Reflectance or transmittance spectrum.
-     * @note Both wo and wi are expected to be oriented away from the surface.
+     * @note Both vectors are expected in the shading coordinate system and oriented away from the surface.
+     */
+    Spectrum evaluate(const Vector &wo, const Vector &wi) const;
+
+    /**
+     * Samples an incident direction proportionally to one of the functions, chosen uniformly.
+     * For non-specular choices, the returned value and density account for all non-specular functions.
+     * @param wo Outgoing light direction.
+     * @param wi Incident light direction, chosen by the function.
+     * @param u1 Random value, uniformly sampled from [0,1) interval.
+     * @param u2 Random value, uniformly sampled from [0,1) interval.
+     * @param u3 Random value used to choose the function, uniformly sampled from [0,1) interval.
+     * @param pdf Probability density of the chosen direction; 0 if no direction could be sampled.
+     * @param sampled_type If not null, receives the type of the chosen function.
+     * @returns Reflectance or transmittance spectrum for the chosen direction.
      */
-    Spectrum evaluate(const Vector &wi, const Vector &wo) const;
+    Spectrum sample(const Vector &wo, Vector &wi, float u1, float u2, float u3, float *pdf,
+            BxDF::Type *sampled_type = nullptr) const;
+
+    /**
+     * Probability density of BSDF::sample choosing 'wi' for given 'wo'.
+     */
+    float pdf(const Vector &wo, const Vector &wi) const;
+
     void add(BxDF * bxdf);
-    ~BSDF();
+    int num_components() const { return _count; }
+
+    /** Maximum number of functions in a BSDF. */
+    static const int MaxBxDFs = 4;
 
 protected:
-    std::vector<BxDF *> _bxdfs;
+    BxDF *_bxdfs[MaxBxDFs];
+    int _count = 0;
 };
 
 
@@ -0,0 +1,80 @@
+#ifndef GILL_CORE_DENOISER_H_
+#define GILL_CORE_DENOISER_H_
+
+#include <string>
+#include <vector>
+
+#include "core/spectrum.h"
+#include "core/vector.h"
+
+namespace gill { namespace core {
+
+/**
+ * Auxiliary features of a camera path, recorded at its first hit that is not a mirror (or its last hit,
+ * if the path ends on a chain of mirrors), guiding a gill::core::Denoiser along geometric and material edges.
+ */
+struct SurfaceFeatures {
+    bool hit = false; /// False if the camera ray left the scene
+    RGB albedo; /// Color of the surface's material, clamped to [0,1]
+    Vector normal; /// Shading normal, facing the incoming ray
+    float depth = 0.f; /// Length of the path up to the hit
+};
+
+/** Smallest albedo divided out by demodulate; darker color channels are filtered as they are. */
+const float MinAlbedo = 0.01f;
+
+/**
+ * Divides radiance by the albedo of the surface it comes from, leaving the illumination, which is smoother
+ * than the radiance across material edges and textures.
+ */
+inline RGB demodulate(const RGB &radiance, const RGB &albedo) {
+    RGB result;
+    for (int i = 0; i < 3; ++i) {
+        result[i] = albedo[i] >= MinAlbedo ? radiance[i] / albedo[i] : radiance[i];
+    }
+    return result;
+}
+
+/**
+ * Inverse of demodulate.
+ */
+inline RGB modulate(const RGB &illumination, const RGB &albedo) {
+    RGB result;
+    for (int i = 0; i < 3; ++i) {
+        result[i] = albedo[i] >= MinAlbedo ? illumination[i] * albedo[i] : illumination[i];
+    }
+    return result;
+}
+
+/**
+ * Noisy image with per-pixel averages of the sample features, row by row from the bottom like gill::core::Film.
+ */
+struct DenoiserInput {
+    int width = 0, height = 0;
+    std::vector<RGB> color; /// Filtered radiance
+    std::vector<RGB> albedo; /// Average albedo of the samples that hit a surface
+    std::vector<Vector> normal; /// Normalized average normal (zero if no sample hit a surface)
+    std::vector<float> depth; /// Average depth of the samples that hit a surface
+    std::vector<float> coverage; /// Fraction of the samples that hit a surface
+    std::vector<float> variance; /// Variance of the mean luminance of the samples divided by their albedo
+};
+
+/**
+ * Removes Monte Carlo noise from a rendered image, using the auxiliary features to preserve edges.
+ */
+class Denoiser {
+public:
+    virtual ~Denoiser() {}
+
+    /**
+     * @param input Noisy image and its features.
+     * @param output Receives the denoised radiance of all pixels, in the order of the input.
+     */
+    virtual void denoise(const DenoiserInput &input, std::vector<RGB> &output) const = 0;
+
+    virtual std::string to_string() const = 0;
+};
+
+}}
+
+#endif
@@ -2,8 +2,14 @@
 #define GILL_CORE_FILM_H_
 
 #include <cmath>
+#include <cstdint>
 #include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "core/denoiser.h"
 #include "core/filter.h"
+#include "core/memory.h"
 #include "core/spectrum.h"
 #include "core/sampler.h"
 
@@ -12,27 +18,228 @@ namespace gill { namespace core {
 using namespace std;
 
 /**
- * Medium for capturing the rendering results.
+ * Accumulated radiance of a rectangular image region, stored in cache-line aligned blocks of 8x8 pixels
+ * (row-major blocks of row-major pixels), so that the pixels around a sample (e.g., a filter splat)
+ * span a few cache lines instead of several image rows.
  */
-class Film {
+class PixelBuffer {
 public:
+    /**
+     * Sums of the weighted radiance and the weights of the samples in a pixel, stored as plain floats
+     * (16 bytes, four pixels per cache line) rather than as an RGB, whose SIMD alignment would pad it to 32 bytes.
+     */
     struct Pixel {
-        Spectrum radiance;
+        float radiance[3];
         float weight;
+
+        Pixel() : radiance{0.f, 0.f, 0.f}, weight(0.f) {}
+
+        inline RGB total_radiance() const {
+            return RGB(radiance[0], radiance[1], radiance[2]);
+        }
+
+        inline void add_radiance(const RGB &value) {
+            radiance[0] += value[0];
+            radiance[1] += value[1];
+            radiance[2] += value[2];
+        }
     };
 
+    static_assert(sizeof(Pixel) == 4 * sizeof(float), "film pixels must not be padded");
+
+    static const int BlockSize = 8;
+    static const size_t CacheLineSize = 64;
+
+    /**
+     * @param x_min Minimum X-value of the region (in pixels).
+     * @param x_max Maximum X-value of the region (inclusive).
+     * @param y_min Minimum Y-value of the region.
+     * @param y_max Maximum Y-value of the region (inclusive).
+     */
+    PixelBuffer(int x_min, int x_max, int y_min, int y_max)
+        : _x_min(x_min), _x_max(x_max), _y_min(y_min), _y_max(y_max) {
+        _xblocks = std::max(0, (x_max - x_min + BlockSize) / BlockSize);
+        int yblocks = std::max(0, (y_max - y_min + BlockSize) / BlockSize);
+        _count = (size_t)_xblocks * yblocks * BlockSize * BlockSize;
+        _storage = new char[_count * sizeof(Pixel) + CacheLineSize];
+        _pixels = reinterpret_cast<Pixel *>((reinterpret_cast<uintptr_t>(_storage) + CacheLineSize - 1) & ~(CacheLineSize - 1));
+        for (size_t i = 0; i < _count; ++i) {
+            new (&_pixels[i]) Pixel();
+        }
+    }
+
+    PixelBuffer(const PixelBuffer &) = delete;
+    PixelBuffer &operator=(const PixelBuffer &) = delete;
+
+    ~PixelBuffer() {
+        delete[] _storage;
+    }
+
+    int x_min() const { return _x_min; }
+    int x_max() const { return _x_max; }
+    int y_min() const { return _y_min; }
+    int y_max() const { return _y_max; }
+
+    /** @returns True if the region has no pixels (e.g., a tile clipped away by the image bounds). */
+    bool empty() const {
+        return _x_min > _x_max || _y_min > _y_max;
+    }
+
+    bool contains(int x, int y) const {
+        return x >= _x_min && x <= _x_max && y >= _y_min && y <= _y_max;
+    }
+
+    inline Pixel &at(int x, int y) {
+        return _pixels[index(x, y)];
+    }
+
+    inline const Pixel &at(int x, int y) const {
+        return _pixels[index(x, y)];
+    }
+
+    void clear() {
+        for (size_t i = 0; i < _count; ++i) {
+            _pixels[i] = Pixel();
+        }
+    }
+
+    /**
+     * Adds all pixels of another buffer, which must lie within this buffer's region.
+     */
+    void add(const PixelBuffer &buffer) {
+        for (int y = buffer._y_min; y <= buffer._y_max; ++y) {
+            for (int x = buffer._x_min; x <= buffer._x_max; ++x) {
+                const Pixel &src = buffer.at(x, y);
+                Pixel &dst = at(x, y);
+                dst.add_radiance(src.total_radiance());
+                dst.weight += src.weight;
+            }
+        }
+    }
+
+    /**
+     * Writes the raw accumulated values (radiance and weight of each pixel, row by row) in binary form.
+     */
+    void write(std::ostream &out) const {
+        for (int y = _y_min; y <= _y_max; ++y) {
+            for (int x = _x_min; x <= _x_max; ++x) {
+                const Pixel &pixel = at(x, y);
+                float values[4] = { pixel.radiance[0], pixel.radiance[1], pixel.radiance[2], pixel.weight };
+                out.write(reinterpret_cast<const char *>(values), sizeof(values));
+            }
+        }
+    }
+
+    /**
+     * Reads values written by PixelBuffer::write for a region of the same size.
+     * @returns False if the stream ended prematurely.
+     */
+    bool read(std::istream &in) {
+        for (int y = _y_min; y <= _y_max; ++y) {
+            for (int x = _x_min; x <= _x_max; ++x) {
+                float values[4];
+                if (!in.read(reinterpret_cast<char *>(values), sizeof(values))) {
+                    return false;
+                }
+                Pixel &pixel = at(x, y);
+                pixel.radiance[0] = values[0];
+                pixel.radiance[1] = values[1];
+                pixel.radiance[2] = values[2];
+                pixel.weight = values[3];
+            }
+        }
+        return true;
+    }
+
+    /** @returns Size of the pixels, including the padding of partial blocks. */
+    size_t memory_usage() const {
+        return _count * sizeof(Pixel);
+    }
+
+protected:
+    inline size_t index(int x, int y) const {
+        unsigned int px = x - _x_min, py = y - _y_min;
+        unsigned int block = (py / BlockSize) * _xblocks + px / BlockSize;
+        return block * (BlockSize * BlockSize) + (py % BlockSize) * BlockSize + px % BlockSize;
+    }
+
+    int _x_min, _x_max, _y_min, _y_max;
+    int _xblocks;
+    size_t _count;
+    char *_storage;
+    Pixel *_pixels; /// First cache-line aligned address in _storage
+};
+
+class FilmTile;
+
+/**
+ * Medium for capturing the rendering results.
+ *
+ * Samples can be added to the film directly, or (when rendering with multiple threads) to a FilmTile
+ * accumulating the samples of a render tile, which is merged into the film when the tile completes.
+ */
+class Film {
+public:
+    typedef PixelBuffer::Pixel Pixel;
+
+    /**
+     * Traversal cost (kD-tree nodes visited and geometries tested) of the samples in a pixel.
+     */
+    struct CostPixel {
+        double cost;
+        int samples;
+
+        CostPixel() : cost(0.0), samples(0) {}
+    };
+
+    /**
+     * Sums of the auxiliary features (see gill::core::SurfaceFeatures) of the samples in a pixel, and of the luminance
+     * of their radiance divided by their albedo and its square, for the denoiser's variance estimate.
+     */
+    struct FeaturePixel {
+        RGB albedo;
+        Vector normal;
+        float depth;
+        float luminance, luminance_sq;
+        int hits; /// Samples that hit a surface (the albedo, normal and depth are summed over these)
+        int samples;
+
+        FeaturePixel() : normal(0.f), depth(0.f), luminance(0.f), luminance_sq(0.f), hits(0), samples(0) {}
+
+        FeaturePixel &operator+=(const FeaturePixel &rhs) {
+            albedo += rhs.albedo;
+            normal += rhs.normal;
+            depth += rhs.depth;
+            luminance += rhs.luminance;
+            luminance_sq += rhs.luminance_sq;
+            hits += rhs.hits;
+            samples += rhs.samples;
+            return *this;
+        }
+    };
+
+    /** Number of values of a gill::core::Film::FeaturePixel written by write_pixels. */
+    static const int FeatureValues = 11;
+
     const int FilterTableSize = 16;
 
     int _xres, _yres; /// Resolution of the film
     float _xdim, _ydim; /// Physical dimensions of the film
     shared_ptr<Filter> _filter;
     float *_filter_table;
-    Pixel *data;
+    PixelBuffer _pixels;
+    CostPixel *_cost; /// Optional heatmap channel, see enable_heatmap
+    FilterSampler *_filter_sampler; /// Set in filter importance sampling mode, see enable_filter_sampling
+    PixelBuffer *_half; /// Optional samples of every other render pass, see enable_noise_estimate
+    FeaturePixel *_features; /// Optional auxiliary features of the samples, see enable_features
+    shared_ptr<Denoiser> _denoiser; /// Optional denoiser, see set_denoiser
+    std::vector<RGB> _denoised; /// Output of the denoiser, see denoise
 
-    Film(int xres, int yres, shared_ptr<Filter> filter) : _xres(xres), _yres(yres), _filter(filter) {
+    Film(int xres, int yres, shared_ptr<Filter> filter)
+        : _xres(xres), _yres(yres), _filter(filter), _pixels(0, xres - 1, 0, yres - 1), _cost(nullptr),
+        _filter_sampler(nullptr), _half(nullptr), _features(nullptr) {
         _xdim = 2.0;
         _ydim = _xdim * (_yres / _xres);
-        data = new Pixel[_xres * _yres];
 
         _filter_table = new float[FilterTableSize * FilterTableSize];
         int i = 0;
@@ -46,15 +253,94 @@ public:
         }
     }
 
-    void add_sample(const Sample &sample, const Spectrum &radiance) {
+    /**
+     * Switches from splatting each sample over the filter window to filter importance sampling,
+     * where camera rays are offset by sample_filter and each sample contributes to a single pixel.
+     */
+    void enable_filter_sampling() {
+        if (!_filter_sampler) {
+            _filter_sampler = new FilterSampler(*_filter);
+        }
+    }
+
+    bool filter_sampling() const {
+        return _filter_sampler != nullptr;
+    }
+
+    /**
+     * In filter importance sampling mode, draws the position of a camera ray from the filter centered
+     * in the pixel of a sample; the sample's position within the pixel is used as the random input,
+     * preserving the sampler's stratification.
+     * @param sample Sample generated by the sampler.
+     * @param shifted Receives the sample with the position of the camera ray.
+     * @returns Weight of the sample, to be passed to add_sample (1 when splatting).
+     */
+    float sample_filter(const Sample &sample, Sample &shifted) const {
+        shifted = sample;
+        if (!_filter_sampler) {
+            return 1.f;
+        }
+        float px = floor(sample.image_x), py = floor(sample.image_y);
+        float dx, dy;
+        float weight = _filter_sampler->sample(sample.image_x - px, sample.image_y - py, dx, dy);
+        shifted.image_x = px + 0.5f + dx;
+        shifted.image_y = py + 0.5f + dy;
+        return weight;
+    }
+
+    /**
+     * Adds radiance carried by a path at given wavelengths, converted into RGB.
+     * @param filter_weight Weight returned by sample_filter for the sample.
+     */
+    void add_sample(const Sample &sample, const Spectrum &radiance, const SampledWavelengths &wavelengths,
+            float filter_weight = 1.f) {
+        add_sample(_pixels, sample, to_rgb(radiance, wavelengths), filter_weight);
+    }
+
+    void add_sample(const Sample &sample, const RGB &radiance) {
+        splat_sample(_pixels, sample, radiance);
+    }
+
+    /**
+     * Adds radiance of a sample to a pixel buffer (the film's own, or that of a FilmTile),
+     * either splatted over the filter window or, in filter importance sampling mode, to a single pixel.
+     */
+    void add_sample(PixelBuffer &buffer, const Sample &sample, const RGB &radiance, float filter_weight) const {
+        if (_filter_sampler) {
+            add_pixel_sample(buffer, sample, radiance, filter_weight);
+        } else {
+            splat_sample(buffer, sample, radiance);
+        }
+    }
+
+    /**
+     * Adds radiance to the pixel containing a sample only (filter importance sampling).
+     * @param weight Weight of the sample, with an expected value of 1 (see gill::core::FilterSampler);
+     * the pixel counts samples rather than summing their (possibly negative) weights.
+     * Samples outside of the buffer's region are discarded rather than added to its border pixels.
+     */
+    void add_pixel_sample(PixelBuffer &buffer, const Sample &sample, const RGB &radiance, float weight) const {
+        int x = (int)floor(sample.image_x), y = (int)floor(sample.image_y);
+        if (!buffer.contains(x, y)) {
+            return;
+        }
+        Pixel &pixel = buffer.at(x, y);
+        pixel.add_radiance(radiance * weight);
+        pixel.weight += 1.f;
+    }
+
+    /**
+     * Adds radiance weighted by the filter to all pixels of a buffer within the filter window around a sample.
+     * Samples whose window misses the buffer's region are discarded.
+     */
+    void splat_sample(PixelBuffer &buffer, const Sample &sample, const RGB &radiance) const {
         float dx = sample.image_x - 0.5f;
         float dy = sample.image_y - 0.5f;
-        int x0 = std::max(0, (int)(ceil(dx - _filter->width())));
-        int x1 = std::min(_xres - 1, (int)(floor(dx + _filter->width())));
-        int y0 = std::max(0, (int)(ceil(dy - _filter->height())));
-        int y1 = std::min(_yres - 1, (int)floor(dy + _filter->height()));
+        int x0 = std::max(buffer.x_min(), (int)(ceil(dx - _filter->width())));
+        int x1 = std::min(buffer.x_max(), (int)(floor(dx + _filter->width())));
+        int y0 = std::max(buffer.y_min(), (int)(ceil(dy - _filter->height())));
+        int y1 = std::min(buffer.y_max(), (int)floor(dy + _filter->height()));
         if ((x1 - x0) < 0 || (y1 - y0) < 0) {
-            cerr << "sample outside of image extent" << endl;
             return;
         }
         for (int y = y0; y <= y1; ++y) {
@@ -63,46 +349,420 @@ public:
                 fx = std::min(fx, (int)(floor(abs(x - dx) * _filter->inv_width() * FilterTableSize)));
                 fy = std::min(fy, (int)(floor(abs(y - dy) * _filter->inv_height() * FilterTableSize)));
                 float weight = _filter_table[fy * FilterTableSize + fx];
-                Pixel &pixel = data[y * _xres + x];
-                pixel.radiance += radiance * weight;
+                Pixel &pixel = buffer.at(x, y);
+                pixel.add_radiance(radiance * weight);
                 pixel.weight += weight;
             }
         }
     }
 
-    Spectrum get_pixel(int x, int y) const {
-        const Pixel &pixel = data[y * _xres + x];
-        //cerr << "got radiance " << pixel.radiance[0] << " " << pixel.radiance[1] << " " << pixel.radiance[2] << " with weight " << pixel.weight << endl;
+    /**
+     * Adds the samples accumulated by a tile to the film; safe to call from multiple threads.
+     * @param half True if the tile belongs to the half of the render passes used for noise estimation.
+     */
+    void merge_tile(const FilmTile &tile, bool half = false);
+
+    /**
+     * Enables the auxiliary channel recording traversal cost of samples, for print_heatmap_ppm.
+     */
+    void enable_heatmap() {
+        if (!_cost) {
+            _cost = new CostPixel[_xres * _yres];
+        }
+    }
+
+    bool has_heatmap() const {
+        return _cost != nullptr;
+    }
+
+    /**
+     * Enables the auxiliary buffer accumulating the samples of every other render pass, for estimate_noise.
+     */
+    void enable_noise_estimate() {
+        if (!_half) {
+            _half = new PixelBuffer(0, _xres - 1, 0, _yres - 1);
+        }
+    }
+
+    bool has_noise_estimate() const {
+        return _half != nullptr;
+    }
+
+    /**
+     * Enables the auxiliary channel recording features (albedo, normal and depth) and luminance statistics
+     * of samples, for denoise.
+     */
+    void enable_features() {
+        if (!_features) {
+            _features = new FeaturePixel[_xres * _yres];
+        }
+    }
+
+    bool has_features() const {
+        return _features != nullptr;
+    }
+
+    /**
+     * Sets the denoiser applied to the image by denoise, enabling the feature channel.
+     */
+    void set_denoiser(shared_ptr<Denoiser> denoiser) {
+        _denoiser = denoiser;
+        enable_features();
+    }
+
+    const shared_ptr<Denoiser> &denoiser() const {
+        return _denoiser;
+    }
+
+    /**
+     * Adds the features of a sample to a pixel (of the film's feature channel, or that of a FilmTile).
+     * @param radiance Radiance of the sample, multiplied by its filter weight (see sample_filter).
+     */
+    static void add_features(FeaturePixel &pixel, const RGB &radiance, const SurfaceFeatures &features) {
+        RGB albedo(1.f);
+        if (features.hit) {
+            pixel.albedo += features.albedo;
+            pixel.normal += features.normal;
+            pixel.depth += features.depth;
+            pixel.hits++;
+            albedo = features.albedo;
+        }
+        float l = luminance(demodulate(radiance, albedo));
+        pixel.luminance += l;
+        pixel.luminance_sq += l * l;
+        pixel.samples++;
+    }
+
+    /**
+     * Replaces the output of the film (see get_radiance) by the image filtered by the denoiser,
+     * guided by the averaged features of each pixel.
+     */
+    void denoise() {
+        _denoised.clear();
+        DenoiserInput input;
+        input.width = _xres;
+        input.height = _yres;
+        size_t count = (size_t)_xres * _yres;
+        input.color.resize(count);
+        input.albedo.resize(count);
+        input.normal.resize(count);
+        input.depth.resize(count);
+        input.coverage.resize(count);
+        input.variance.resize(count);
+        for (int y = 0; y < _yres; ++y) {
+            for (int x = 0; x < _xres; ++x) {
+                size_t i = (size_t)y * _xres + x;
+                const FeaturePixel &pixel = _features[i];
+                input.color[i] = get_radiance(x, y);
+                if (pixel.hits > 0) {
+                    input.albedo[i] = pixel.albedo / pixel.hits;
+                    input.normal[i] = length_squared(pixel.normal) > 0.f ? normalize(pixel.normal) : Vector(0.f);
+                    input.depth[i] = pixel.depth / pixel.hits;
+                }
+                input.coverage[i] = pixel.samples > 0 ? (float)pixel.hits / pixel.samples : 0.f;
+                if (pixel.samples > 1) {
+                    // Unbiased sample variance, divided by the number of samples for the variance of the mean
+                    float mean = pixel.luminance / pixel.samples;
+                    float sample_variance = std::max(0.f, pixel.luminance_sq / pixel.samples - mean * mean)
+                        * pixel.samples / (pixel.samples - 1);
+                    input.variance[i] = sample_variance / pixel.samples;
+                } else {
+                    input.variance[i] = -1.f;
+                }
+            }
+        }
+        _denoiser->denoise(input, _denoised);
+    }
+
+    /**
+     * Estimates the error of the image from the difference between all samples and half of them
+     * (which has the same variance as the error of the full image, for independent passes of equal size).
+     * Pixels without samples in both halves are skipped.
+     * @returns Relative RMS error (square root of relative MSE, with the offset used by gill-quality),
+     * or infinity if no pixel has samples in both halves yet.
+     */
+    float estimate_noise() const {
+        const float RelativeEpsilon = 0.01f;
+        double error = 0.0;
+        size_t count = 0;
+        for (int y = 0; y < _yres; ++y) {
+            for (int x = 0; x < _xres; ++x) {
+                const Pixel &all = _pixels.at(x, y), &half = _half->at(x, y);
+                if (almost_zero(half.weight) || almost_zero(all.weight - half.weight)) {
+                    continue;
+                }
+                RGB full = all.total_radiance() / all.weight, diff = full - half.total_radiance() / half.weight;
+                for (int c = 0; c < 3; ++c) {
+                    error += diff[c] * diff[c] / (full[c] * full[c] + RelativeEpsilon);
+                }
+                count += 3;
+            }
+        }
+        return count > 0 ? std::sqrt(error / count) : Infinity;
+    }
+
+    /**
+     * Writes the raw accumulated pixels (and the noise estimation buffer, if enabled), e.g., for checkpoints.
+     */
+    void write_pixels(std::ostream &out) const {
+        _pixels.write(out);
+        if (_half) {
+            _half->write(out);
+        }
+        if (_features) {
+            for (int i = 0; i < _xres * _yres; ++i) {
+                const FeaturePixel &pixel = _features[i];
+                float values[FeatureValues] = { pixel.albedo[0], pixel.albedo[1], pixel.albedo[2],
+                    pixel.normal.x, pixel.normal.y, pixel.normal.z, pixel.depth, pixel.luminance, pixel.luminance_sq,
+                    (float)pixel.hits, (float)pixel.samples };
+                out.write(reinterpret_cast<const char *>(values), sizeof(values));
+            }
+        }
+    }
+
+    /**
+     * Discards all accumulated samples.
+     */
+    void clear() {
+        _pixels.clear();
+        if (_half) {
+            _half->clear();
+        }
+        if (_features) {
+            std::fill(_features, _features + _xres * _yres, FeaturePixel());
+        }
+        _denoised.clear();
+    }
+
+    /**
+     * Restores pixels written by write_pixels from a film of the same resolution and configuration.
+     * @returns False if the data is incomplete.
+     */
+    bool read_pixels(std::istream &in) {
+        if (!_pixels.read(in) || (_half && !_half->read(in))) {
+            return false;
+        }
+        if (_features) {
+            for (int i = 0; i < _xres * _yres; ++i) {
+                float values[FeatureValues];
+                if (!in.read(reinterpret_cast<char *>(values), sizeof(values))) {
+                    return false;
+                }
+                FeaturePixel &pixel = _features[i];
+                pixel.albedo = RGB(values[0], values[1], values[2]);
+                pixel.normal = Vector(values[3], values[4], values[5]);
+                pixel.depth = values[6];
+                pixel.luminance = values[7];
+                pixel.luminance_sq = values[8];
+                pixel.hits = (int)values[9];
+                pixel.samples = (int)values[10];
+            }
+        }
+        return true;
+    }
+
+    void memory_usage(MemoryUsage &usage) const {
+        usage.film_pixels += _pixels.memory_usage() + (_cost ? _xres * _yres * sizeof(CostPixel) : 0)
+            + (_half ? _half->memory_usage() : 0) + (_features ? _xres * _yres * sizeof(FeaturePixel) : 0)
+            + _denoised.capacity() * sizeof(RGB);
+        usage.filter_tables += FilterTableSize * FilterTableSize * sizeof(float)
+            + (_filter_sampler ? _filter_sampler->memory_usage() : 0);
+    }
+
+    /**
+     * Records traversal cost of a sample in the pixel containing it (without filtering).
+     * Samples outside of the image (e.g., of a sampler window larger than the film) are ignored,
+     * so that each pixel is only updated by the thread rendering the tile it lies in.
+     */
+    void add_cost(const Sample &sample, uint64_t cost) {
+        int x = (int)floor(sample.image_x), y = (int)floor(sample.image_y);
+        if (x < 0 || x >= _xres || y < 0 || y >= _yres) {
+            return;
+        }
+        CostPixel &pixel = _cost[y * _xres + x];
+        pixel.cost += cost;
+        pixel.samples++;
+    }
+
+    /**
+     * @returns Filtered (and denoised, after denoise) radiance of a pixel, without clamping (e.g., for error metrics).
+     */
+    RGB get_radiance(int x, int y) const {
+        if (!_denoised.empty()) {
+            return _denoised[y * _xres + x];
+        }
+        const Pixel &pixel = _pixels.at(x, y);
         if (almost_zero(pixel.weight)) {
-            return Spectrum(0.0);
+            return RGB(0.0);
         } else {
-            return clamp(pixel.radiance / pixel.weight, 0.f, 1.f);
+            return pixel.total_radiance() / pixel.weight;
+        }
+    }
+
+    RGB get_pixel(int x, int y) const {
+        if (!_denoised.empty()) {
+            return clamp(_denoised[y * _xres + x], 0.f, 1.f);
+        }
+        const Pixel &pixel = _pixels.at(x, y);
+        if (almost_zero(pixel.weight)) {
+            return RGB(0.0);
+        } else {
+            return clamp(pixel.total_radiance() / pixel.weight, 0.f, 1.f);
         }
     }
 
     ~Film() {
         delete[] _filter_table;
-        delete[] data;
+        delete[] _cost;
+        delete _filter_sampler;
+        delete _half;
+        delete[] _features;
     }
 
-    void print_ppm() const {
-        std::cout << "P3" << std::endl;
-        std::cout << _xres << " " << _yres << std::endl;
-        std::cout << "255" << std::endl;
+    void print_ppm(std::ostream &out = std::cout) const {
+        out << "P3" << std::endl;
+        out << _xres << " " << _yres << std::endl;
+        out << "255" << std::endl;
         for (int y = 0; y < _yres; ++y) {
             for (int x = 0; x < _xres; ++x) {
-                Spectrum spectrum = get_pixel(x, _yres - 1 - y);
-                std::cout << (int)(spectrum[0] * 255) << " ";
-                std::cout << (int)(spectrum[1] * 255) << " ";
-                std::cout << (int)(spectrum[2] * 255) << " ";
+                RGB spectrum = get_pixel(x, _yres - 1 - y);
+                out << (int)(spectrum[0] * 255) << " ";
+                out << (int)(spectrum[1] * 255) << " ";
+                out << (int)(spectrum[2] * 255) << " ";
             }
-            std::cout << std::endl;
+            out << std::endl;
+        }
+    }
+
+    /**
+     * Prints the average traversal cost per sample as a false-color (blue-green-red) image.
+     * The colors are scaled to the 99th percentile of the pixel costs, so that a few
+     * outliers do not hide the structure of the rest of the image; the scale is stored in a comment.
+     */
+    void print_heatmap_ppm(std::ostream &out) const {
+        std::vector<float> costs(_xres * _yres, 0.f);
+        for (int i = 0; i < _xres * _yres; ++i) {
+            if (_cost[i].samples > 0) {
+                costs[i] = _cost[i].cost / _cost[i].samples;
+            }
+        }
+        std::vector<float> sorted(costs);
+        std::sort(sorted.begin(), sorted.end());
+        float scale = std::max(1.f, sorted[(sorted.size() - 1) * 99 / 100]);
+
+        out << "P3" << std::endl;
+        out << "# traversal cost per sample, red = " << scale << std::endl;
+        out << _xres << " " << _yres << std::endl;
+        out << "255" << std::endl;
+        for (int y = 0; y < _yres; ++y) {
+            for (int x = 0; x < _xres; ++x) {
+                float v = std::min(1.f, costs[(_yres - 1 - y) * _xres + x] / scale);
+                // Piecewise linear blue -> cyan -> green -> yellow -> red
+                float r = clamp(4.f * v - 2.f, 0.f, 1.f);
+                float g = v < 0.75f ? clamp(4.f * v, 0.f, 1.f) : clamp(4.f - 4.f * v, 0.f, 1.f);
+                float b = clamp(2.f - 4.f * v, 0.f, 1.f);
+                out << (int)(r * 255) << " " << (int)(g * 255) << " " << (int)(b * 255) << " ";
+            }
+            out << std::endl;
         }
     }
 
     friend std::ostream& operator<<(std::ostream& out, const Film& film);
+
+protected:
+    std::mutex _merge_mutex;
 };
 
+/**
+ * Thread-local accumulation buffer of a render tile, covering the tile's pixels expanded by the filter window
+ * (clipped to the image), so that threads rendering adjacent tiles never write to the same pixels.
+ * If the film records features, the tile records those of its own pixels within the image (they are not filtered).
+ */
+class FilmTile {
+public:
+    /**
+     * @param film Film the tile will be merged into.
+     * @param x_min Minimum X-value of the pixels sampled by the tile.
+     * @param x_max Maximum X-value of the pixels sampled by the tile (inclusive).
+     * @param y_min Minimum Y-value of the pixels sampled by the tile.
+     * @param y_max Maximum Y-value of the pixels sampled by the tile (inclusive).
+     */
+    FilmTile(const Film *film, int x_min, int x_max, int y_min, int y_max)
+        : _film(film),
+        _pixels(std::max(0, x_min - margin(film->_filter->width())), std::min(film->_xres - 1, x_max + margin(film->_filter->width())),
+            std::max(0, y_min - margin(film->_filter->height())), std::min(film->_yres - 1, y_max + margin(film->_filter->height()))),
+        _x_min(std::max(0, x_min)), _x_max(std::min(film->_xres - 1, x_max)),
+        _y_min(std::max(0, y_min)), _y_max(std::min(film->_yres - 1, y_max)) {
+        if (film->has_features() && _x_min <= _x_max && _y_min <= _y_max) {
+            _features.resize((size_t)(_x_max - _x_min + 1) * (_y_max - _y_min + 1));
+        }
+    }
+
+    /**
+     * Adds radiance of a sample (converted into RGB), see Film::add_sample.
+     */
+    void add_sample(const Sample &sample, const RGB &radiance, float filter_weight = 1.f) {
+        _film->add_sample(_pixels, sample, radiance, filter_weight);
+    }
+
+    bool has_features() const {
+        return !_features.empty();
+    }
+
+    /**
+     * Adds the features of a sample to the pixel containing it, see Film::add_features.
+     * Samples outside of the tile's pixels within the image are skipped silently: the sampler's window may
+     * extend past the film.
+     */
+    void add_features(const Sample &sample, const RGB &radiance, const SurfaceFeatures &features) {
+        int x = (int)floor(sample.image_x), y = (int)floor(sample.image_y);
+        if (x < _x_min || x > _x_max || y < _y_min || y > _y_max) {
+            return;
+        }
+        Film::add_features(_features[(y - _y_min) * (_x_max - _x_min + 1) + x - _x_min], radiance, features);
+    }
+
+    const PixelBuffer &pixels() const {
+        return _pixels;
+    }
+
+    /** @returns True if no sample of the tile can reach a pixel of the image. */
+    bool empty() const {
+        return _pixels.empty();
+    }
+
+protected:
+    friend class Film;
+
+    /** Pixels beyond the tile reached by filter splats of samples within the tile. */
+    static int margin(float filter_radius) {
+        return (int)ceil(filter_radius) + 1;
+    }
+
+    const Film *_film;
+    PixelBuffer _pixels;
+    int _x_min, _x_max, _y_min, _y_max; /// Pixels sampled by the tile, clipped to the image
+    std::vector<Film::FeaturePixel> _features; /// Features of the sampled pixels (row-major), if the film records them
+};
+
+inline void Film::merge_tile(const FilmTile &tile, bool half) {
+    if (tile.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_merge_mutex);
+    _pixels.add(tile.pixels());
+    if (half && _half) {
+        _half->add(tile.pixels());
+    }
+    if (tile.has_features() && _features) {
+        for (int y = tile._y_min; y <= tile._y_max; ++y) {
+            for (int x = tile._x_min; x <= tile._x_max; ++x) {
+                _features[y * _xres + x] += tile._features[(y - tile._y_min) * (tile._x_max - tile._x_min + 1) + x - tile._x_min];
+            }
+        }
+    }
+}
+
 }}
 
 #endif
@@ -1,3 +1,5 @@
+#include <cmath>
+
 #include "core/filter.h"
 
 namespace gill { namespace core {
@@ -7,4 +9,54 @@ Filter::Filter(float width, float height)
 
 Filter::~Filter() {}
 
+FilterSampler::FilterSampler(const Filter &filter) : _width(filter.width()), _height(filter.height()) {
+    _xcells = std::max(1, (int)std::ceil(2.f * _width * CellsPerUnit));
+    _ycells = std::max(1, (int)std::ceil(2.f * _height * CellsPerUnit));
+    _values.resize(_xcells * _ycells);
+    std::vector<float> abs_values(_xcells), row_integrals(_ycells);
+    for (int y = 0; y < _ycells; ++y) {
+        float fy = -_height + (y + 0.5f) * 2.f * _height / _ycells;
+        for (int x = 0; x < _xcells; ++x) {
+            float fx = -_width + (x + 0.5f) * 2.f * _width / _xcells;
+            float value = filter.evaluate(fx, fy);
+            _values[y * _xcells + x] = value;
+            abs_values[x] = std::abs(value);
+        }
+        _conditional.emplace_back(new Distribution1D(&abs_values[0], _xcells));
+        row_integrals[y] = _conditional.back()->integral();
+    }
+    _marginal.reset(new Distribution1D(&row_integrals[0], _ycells));
+
+    float integral = 0.f;
+    for (float value : _values) {
+        integral += value;
+    }
+    integral *= 4.f * _width * _height / _values.size();
+    if (integral != 0.f) {
+        for (float &value : _values) {
+            value /= integral;
+        }
+    }
+}
+
+float FilterSampler::sample(float u1, float u2, float &dx, float &dy) const {
+    float pdf_y, pdf_x;
+    int row, column;
+    float sy = _marginal->sample(u2, &pdf_y, &row);
+    float sx = _conditional[row]->sample(u1, &pdf_x, &column);
+    dx = (2.f * sx - 1.f) * _width;
+    dy = (2.f * sy - 1.f) * _height;
+    // Density with respect to the area of the window
+    float pdf = pdf_x * pdf_y / (4.f * _width * _height);
+    return pdf > 0.f ? _values[row * _xcells + column] / pdf : 0.f;
+}
+
+size_t FilterSampler::memory_usage() const {
+    size_t size = _values.size() * sizeof(float) + _marginal->memory_usage();
+    for (auto &distribution : _conditional) {
+        size += distribution->memory_usage();
+    }
+    return size;
+}
+
 }}
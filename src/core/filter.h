@@ -1,6 +1,11 @@
 #ifndef GILL_CORE_FILTER_H_
 #define GILL_CORE_FILTER_H_
 
+#include <memory>
+#include <vector>
+
+#include "core/montecarlo.h"
+
 namespace gill { namespace core {
 
 /**
@@ -34,6 +39,44 @@ protected:
     const float _inv_width, _inv_height;
 };
 
+/**
+ * Draws offsets from the center of a filter window proportionally to the absolute value of the filter,
+ * for filter importance sampling: each sample contributes to a single pixel with the weight returned
+ * by FilterSampler::sample, instead of being splatted with filter weights to all pixels in the window.
+ *
+ * The filter is tabulated into cells, and the weight is the (signed) tabulated value divided by the density,
+ * i.e., constant in magnitude, so filters with negative lobes (e.g., Mitchell) produce negative weights.
+ * The weights are normalized by the signed integral of the filter, so that their expected value is 1:
+ * pixels average the weighted samples, rather than dividing by the sum of the weights, which may get
+ * arbitrarily close to zero when positive and negative weights cancel out.
+ */
+class FilterSampler {
+public:
+    /** Number of table cells per unit of the filter's half-width/half-height. */
+    static const int CellsPerUnit = 16;
+
+    FilterSampler(const Filter &filter);
+
+    /**
+     * Converts two random values into an offset from the center of the filter window.
+     * @param u1 Random value, uniformly sampled from [0,1) interval.
+     * @param u2 Random value, uniformly sampled from [0,1) interval.
+     * @param dx X-offset of the sample, in [-width,width].
+     * @param dy Y-offset of the sample, in [-height,height].
+     * @returns Weight of the sample.
+     */
+    float sample(float u1, float u2, float &dx, float &dy) const;
+
+    size_t memory_usage() const;
+
+protected:
+    float _width, _height;
+    int _xcells, _ycells;
+    std::vector<float> _values; /// Signed filter values divided by the signed integral, row-major
+    std::unique_ptr<Distribution1D> _marginal; /// Over rows
+    std::vector<std::unique_ptr<Distribution1D>> _conditional; /// Over the cells of each row
+};
+
 }}
 
 #endif
@@ -19,7 +19,7 @@ Spectrum Fresnel::evaluate(float cos_i) const {
 Spectrum fresnel_diel(float cos_i, float cos_t, const Spectrum &eta_i, const Spectrum &eta_t) {
     Spectrum parl_refl = (eta_t * cos_i - eta_i * cos_t) / (eta_t * cos_i + eta_i * cos_t);
     Spectrum perp_refl = (eta_i * cos_i - eta_t * cos_t) / (eta_i * cos_i + eta_t * cos_t);
-    return (parl_refl * parl_refl + perp_refl + perp_refl) * 0.5f;
+    return (parl_refl * parl_refl + perp_refl * perp_refl) * 0.5f;
 }
 
 Spectrum FresnelDielectric::evaluate(float cos_i) const {
@@ -26,7 +26,7 @@ public:
  */
 class FresnelDielectric : public Fresnel {
 public:
-    FresnelDielectric(float eta_i, float &eta_t) : _eta_i(eta_i), _eta_t(eta_t) {}
+    FresnelDielectric(float eta_i, float eta_t) : _eta_i(eta_i), _eta_t(eta_t) {}
     Spectrum evaluate(float cos_i) const override;
 
 protected:
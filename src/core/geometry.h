@@ -8,9 +8,12 @@
 #include "core/ray.h"
 #include "core/bbox.h"
 #include "core/intersection.h"
+#include "core/memory.h"
 
 namespace gill { namespace core {
 
+class KdTree;
+
 /**
  * Abstraction of a geometry, able to define its bounds and compute ray intersections.
  */
@@ -18,7 +21,27 @@ class Geometry {
 public:
     virtual BBox bounds() const = 0;
     virtual bool intersect(const Ray &ray, float &t, Intersection *i) const = 0;
+
+    /**
+     * Computes surface data of a hit found by Geometry::intersect.
+     * @param ray Ray defined in local coordinate system (the same as passed to Geometry::intersect).
+     * @param t Parametric distance of the hit along the ray.
+     * @param isec Hit record.
+     * @param si Surface data to be filled (in local coordinate system).
+     */
+    virtual void compute_surface_interaction(const Ray &ray, float t, const Intersection &isec,
+            SurfaceInteraction &si) const = 0;
     virtual int num_faces() const = 0;
+
+    /**
+     * Adds memory held by the geometry (beyond the object itself) to given usage.
+     */
+    virtual void memory_usage(MemoryUsage &usage) const {}
+
+    /**
+     * @returns Accelerator of the geometry, if it has any.
+     */
+    virtual KdTree* accelerator() const { return nullptr; }
 };
 
 }}
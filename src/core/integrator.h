@@ -3,6 +3,8 @@
 
 #include <iostream>
 
+#include "core/denoiser.h"
+#include "core/memory.h"
 #include "core/spectrum.h"
 #include "core/ray.h"
 #include "core/scene.h"
@@ -13,7 +15,20 @@ namespace gill { namespace core {
 class SurfaceIntegrator {
 public:
     virtual ~SurfaceIntegrator() {};
-    virtual Spectrum Li(const Ray &ray, const Scene *scene, const Sample &sample) const = 0;
+
+    /**
+     * Computes radiance arriving along a camera ray.
+     * @param ray Camera ray.
+     * @param scene Scene to be rendered.
+     * @param sample Image sample the ray was generated from.
+     * @param wavelengths Wavelengths carried by the path (spectral mode only), updated when secondary ones are terminated.
+     * @param rng Random number generator of the rendering thread, used for sampling light paths.
+     * @param arena Memory arena of the rendering thread for shading data, reset by the caller after each sample.
+     * @param features Optionally receives the auxiliary features of the path (for denoising).
+     */
+    virtual Spectrum Li(const Ray &ray, const Scene *scene, const Sample &sample,
+            SampledWavelengths &wavelengths, RNG &rng, MemoryArena &arena,
+            SurfaceFeatures *features = nullptr) const = 0;
 };
 
 }}
@@ -1,21 +1,37 @@
 #ifndef GILL_CORE_INTERSECTION_H_
 #define GILL_CORE_INTERSECTION_H_
 
+#include <cstdint>
+
 #include "core/vector.h"
-#include "core/spectrum.h"
 
 namespace gill { namespace core {
 
+class Primitive;
+
+/** Index of a material in the scene's gill::core::MaterialTable. */
+typedef uint16_t MaterialId;
+
 /**
- * Collection of data related to a specific primitive intersection.
+ * Minimal record of a ray hit, updated by every closer hit found during traversal.
+ * The full surface data is only computed for the final, closest hit (see gill::core::SurfaceInteraction).
  */
 struct Intersection {
+    const Primitive *primitive;
+    uint32_t face; /// Index of the face (e.g., mesh triangle) within the primitive's geometry
+    float u, v; /// Barycentric coordinates of the hit on the face (triangles only)
+};
+
+/**
+ * Geometric and material data of the surface at the closest hit of a ray.
+ * @note Geometries fill it in their local coordinate system; gill::core::Primitive::compute_surface_interaction
+ * converts it to world space.
+ */
+struct SurfaceInteraction {
     Point p;
     Normal n;
-    float u, v;
     Vector dpdu, dpdv;
-    Normal dndu, dndv;
-    Spectrum emit, diff, refl, trsm;
+    MaterialId material;
 };
 
 }}
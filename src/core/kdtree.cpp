@@ -1,4 +1,11 @@
+#include <chrono>
+#include <sstream>
+
 #include "core/kdtree.h"
+#include "core/montecarlo.h"
+#include "core/random.h"
+#include "core/stats.h"
+#include "core/trace.h"
 
 namespace gill { namespace core {
 
@@ -106,12 +113,16 @@ int KdTree::build(const BBox &node_bounds, BBox *geom_bounds, Edge *edges[3],
 KdTree::KdTree(uint32_t geom_count, float isec_cost, float trav_cost, int max_geoms, int max_depth,
         std::function<BBox(uint32_t)> bounds_func, std::function<bool(uint32_t, const Ray&, float&, Intersection*)> isec_func)
         : _isec_cost(isec_cost), _trav_cost(trav_cost), _max_geoms(max_geoms), _max_depth(max_depth),
-        _bounds_func(bounds_func), _isec_func(isec_func) {
+        _build_scratch(0), _flags(0), _bounds_func(bounds_func), _isec_func(isec_func) {
+    TraceScope trace("build_kdtree", "build");
+    trace.arg("geometries", geom_count);
     _nodes.reserve(16);
     BBox *geom_bounds = new BBox[geom_count];
     uint32_t *overlapping = new uint32_t[geom_count];
     uint32_t *below = new uint32_t[geom_count];
     uint32_t *above = new uint32_t[(max_depth + 1) * geom_count];
+    _build_scratch = geom_count * (sizeof(BBox) + 2 * sizeof(uint32_t) + 6 * sizeof(Edge))
+        + (max_depth + 1) * geom_count * sizeof(uint32_t);
     for (uint32_t i = 0; i < geom_count; ++i) {
         geom_bounds[i] = _bounds_func(i);
         _total_bounds += geom_bounds[i];
@@ -131,11 +142,32 @@ KdTree::KdTree(uint32_t geom_count, float isec_cost, float trav_cost, int max_ge
 
 KdTree::KdTree(const char *filename,
         std::function<BBox(uint32_t)> bounds_func, std::function<bool(uint32_t, const Ray&, float&, Intersection*)> isec_func)
-        : _bounds_func(bounds_func), _isec_func(isec_func) {
+        : _build_scratch(0), _flags(0), _bounds_func(bounds_func), _isec_func(isec_func) {
+    TraceScope trace("load_kdtree", "parse");
+    trace.arg("file", filename);
     load(filename);
 }
 
+/** Cost of the calling thread's traversals, set by gill::core::TraversalCostScope (null if not recorded). */
+static thread_local TraversalCost *traversal_cost = nullptr;
+
+TraversalCostScope::TraversalCostScope(TraversalCost *cost) : _previous(traversal_cost) {
+    traversal_cost = cost;
+}
+
+TraversalCostScope::~TraversalCostScope() {
+    traversal_cost = _previous;
+}
+
+static inline void add_traversal_cost(uint32_t nodes, uint32_t tests) {
+    if (traversal_cost) {
+        traversal_cost->nodes += nodes;
+        traversal_cost->tests += tests;
+    }
+}
+
 bool KdTree::intersect(const Ray &ray, float &t, Intersection *isec) {
+    STAT(kdtree_traversals++);
     float tmin, tmax;
     if (!_total_bounds.intersects(ray, tmin, tmax)) {
         return false;
@@ -144,25 +176,32 @@ bool KdTree::intersect(const Ray &ray, float &t, Intersection *isec) {
     TreeSegment segments[MaxTreeSegments];
     segments[0] = { &_nodes[0], tmin, tmax };
     int num_segments = 1;
+    // Counted locally, and added to the thread's traversal cost (if recorded) once per traversal
+    uint32_t visited = 0, tested = 0;
 
     while (num_segments-- > 0) {
         TreeSegment segment = segments[num_segments];
+        visited++;
         if (segment.node->is_leaf()) {
+            STAT(kdtree_leaves++);
             int geom_index = segment.node->header >> 2;
             int geom_count = segment.node->geom_count;
             float old_t = t;
             bool hit = false;
+            tested += geom_count;
             for (int i = geom_index; i < geom_index + geom_count; ++i) {
                 hit |= _isec_func(_geom_refs[i], ray, t, isec);
             }
             if (hit) {
                 if (t >= segment.tmin && t <= segment.tmax) {
+                    add_traversal_cost(visited, tested);
                     return true;
                 } else {
                     t = old_t; // The closest 't' has changed and must be reset
                 }
             }
         } else {
+            STAT(kdtree_nodes++);
             float split = segment.node->split;
             int split_axis = segment.node->split_axis();
             float ro = ray.o[split_axis], rd = ray.d[split_axis];
@@ -191,6 +230,7 @@ bool KdTree::intersect(const Ray &ray, float &t, Intersection *isec) {
         }
     }
 
+    add_traversal_cost(visited, tested);
     return false;
 }
 
@@ -198,6 +238,12 @@ BBox KdTree::bounds() {
     return _total_bounds;
 }
 
+void KdTree::memory_usage(MemoryUsage &usage) const {
+    usage.kdtree_nodes += _nodes.capacity() * sizeof(Node);
+    usage.kdtree_refs += _geom_refs.capacity() * sizeof(uint32_t);
+    usage.build_scratch_peak = std::max(usage.build_scratch_peak, _build_scratch);
+}
+
 void KdTree::print_info() {
     std::cerr << "Intersection Cost: " << _isec_cost << std::endl;
     std::cerr << "Traverse Cost: " << _trav_cost << std::endl;
@@ -207,6 +253,174 @@ void KdTree::print_info() {
     std::cerr << "Geom Refs: " << _geom_refs.size() << std::endl;
 }
 
+/**
+ * Generates random rays from a sphere around given bounds, aimed at random points inside the bounds.
+ */
+static std::vector<Ray> random_rays(const BBox &bounds, int num_rays, unsigned int seed) {
+    RNG rng(seed);
+    Point center = bounds.min + (bounds.max - bounds.min) * 0.5f;
+    float radius = length(bounds.max - bounds.min);
+    std::vector<Ray> rays;
+    rays.reserve(num_rays);
+    for (int i = 0; i < num_rays; ++i) {
+        Vector offset = uniform_sphere_sample(random_float(rng, 0.f, 1.f), random_float(rng, 0.f, 1.f));
+        Point origin = center + offset * radius;
+        Point target(random_float(rng, bounds.min.x, bounds.max.x),
+            random_float(rng, bounds.min.y, bounds.max.y),
+            random_float(rng, bounds.min.z, bounds.max.z));
+        rays.push_back(Ray(origin, normalize(target - origin)));
+    }
+    return rays;
+}
+
+/** Seed of the ray set used for tuning the build parameters. */
+const unsigned int TuningSeed = 11;
+/** Number of timed passes over the ray set per candidate tree (the fastest one is used). */
+const int TuningPasses = 3;
+
+std::unique_ptr<KdTree> KdTree::tune(uint32_t geom_count, const KdTreeParams &initial, int num_rays,
+        std::function<BBox(uint32_t)> bounds_func,
+        std::function<bool(uint32_t, const Ray&, float&, Intersection*)> isec_func) {
+    TraceScope trace("tune_kdtree", "build");
+    trace.arg("geometries", geom_count);
+    std::unique_ptr<KdTree> best(new KdTree(geom_count, initial.isec_cost, initial.trav_cost,
+        initial.max_geoms, initial.max_depth, bounds_func, isec_func));
+    std::vector<Ray> rays = random_rays(best->_total_bounds, num_rays, TuningSeed);
+    auto measure = [&rays](KdTree &tree) {
+        double fastest = Infinity;
+        for (int pass = 0; pass < TuningPasses; ++pass) {
+            auto begin_time = std::chrono::high_resolution_clock::now();
+            for (const Ray &ray : rays) {
+                Intersection isec;
+                float t = Infinity;
+                tree.intersect(ray, t, &isec);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - begin_time;
+            fastest = std::min(fastest, elapsed.count());
+        }
+        return fastest;
+    };
+    double best_time = measure(*best);
+
+    // Candidate values of each parameter, searched one parameter at a time
+    int log_count = std::max(1, (int)std::ceil(std::log2((float)std::max(geom_count, 1u))));
+    std::vector<float> cost_ratios = { 2.f, 4.f, 8.f, 16.f };
+    std::vector<int> leaf_sizes = { 1, 2, 4, 8, 16 };
+    std::vector<int> depths = { (int)(8 + 1.3f * log_count), 24, 32 };
+    for (int param = 0; param < 3; ++param) {
+        KdTreeParams current = best->params();
+        int count = param == 0 ? cost_ratios.size() : (param == 1 ? leaf_sizes.size() : depths.size());
+        for (int i = 0; i < count; ++i) {
+            KdTreeParams candidate = current;
+            if (param == 0) {
+                candidate.isec_cost = current.trav_cost * cost_ratios[i];
+            } else if (param == 1) {
+                candidate.max_geoms = leaf_sizes[i];
+            } else {
+                candidate.max_depth = depths[i];
+            }
+            if (candidate.isec_cost == current.isec_cost && candidate.max_geoms == current.max_geoms
+                    && candidate.max_depth == current.max_depth) {
+                continue;
+            }
+            std::unique_ptr<KdTree> tree(new KdTree(geom_count, candidate.isec_cost, candidate.trav_cost,
+                candidate.max_geoms, candidate.max_depth, bounds_func, isec_func));
+            double time = measure(*tree);
+            if (time < best_time) {
+                best_time = time;
+                best = std::move(tree);
+            }
+        }
+    }
+    best->_flags |= KdTreeFlagTuned;
+    return best;
+}
+
+/** Number of bins of the leaf size histogram (the last bin collects all larger leaves). */
+const int LeafSizeBins = 16;
+
+std::string KdTree::analyze(int num_rays, unsigned int seed) {
+    struct Entry {
+        int node;
+        BBox bounds;
+        int depth;
+    };
+    std::vector<int> depths(_max_depth + 1, 0), sizes(LeafSizeBins, 0);
+    double sah = 0.0, inv_root_surface = 1.0 / surface(_total_bounds);
+    int leaves = 0, empty_leaves = 0, max_depth = 0;
+    std::vector<Entry> stack = { { 0, _total_bounds, 0 } };
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const Node &node = _nodes[entry.node];
+        // Probability of a random ray hitting the node, given it hits the root
+        float probability = surface(entry.bounds) * inv_root_surface;
+        if (node.is_leaf()) {
+            leaves++;
+            empty_leaves += node.geom_count == 0;
+            depths[std::min(entry.depth, _max_depth)]++;
+            sizes[std::min<int>(node.geom_count, LeafSizeBins - 1)]++;
+            max_depth = std::max(max_depth, entry.depth);
+            sah += _isec_cost * node.geom_count * probability;
+        } else {
+            sah += _trav_cost * probability;
+            int axis = node.split_axis();
+            BBox below = entry.bounds, above = entry.bounds;
+            below.max[axis] = node.split;
+            above.min[axis] = node.split;
+            stack.push_back({ entry.node + 1, below, entry.depth + 1 });
+            stack.push_back({ node.front_child_offset(), above, entry.depth + 1 });
+        }
+    }
+
+    std::vector<bool> referenced;
+    int geoms = 0;
+    for (uint32_t ref : _geom_refs) {
+        if (ref >= referenced.size()) {
+            referenced.resize(ref + 1, false);
+        }
+        if (!referenced[ref]) {
+            referenced[ref] = true;
+            geoms++;
+        }
+    }
+
+    TraversalCost cost = { 0, 0 };
+    int hits = 0;
+    {
+        TraversalCostScope scope(&cost);
+        for (const Ray &ray : random_rays(_total_bounds, num_rays, seed)) {
+            Intersection isec;
+            float t = Infinity;
+            hits += intersect(ray, t, &isec);
+        }
+    }
+
+    std::ostringstream out;
+    out << "{\"params\":" << params() << ",\"tuned\":" << (tuned() ? "true" : "false");
+    out << ",\"nodes\":" << _nodes.size() << ",\"leaves\":" << leaves << ",\"geometries\":" << geoms
+        << ",\"refs\":" << _geom_refs.size() << ",\"sah_cost\":" << sah
+        << ",\"max_depth\":" << max_depth
+        << ",\"empty_leaf_ratio\":" << (leaves > 0 ? (double)empty_leaves / leaves : 0.0)
+        << ",\"duplication_factor\":" << (geoms > 0 ? (double)_geom_refs.size() / geoms : 0.0);
+    out << ",\"leaf_depths\":[";
+    for (int i = 0; i <= max_depth; ++i) {
+        out << (i > 0 ? "," : "") << depths[i];
+    }
+    out << "],\"leaf_sizes\":[";
+    for (int i = 0; i < LeafSizeBins; ++i) {
+        out << (i > 0 ? "," : "") << sizes[i];
+    }
+    out << "]";
+    if (num_rays > 0) {
+        out << ",\"rays\":" << num_rays << ",\"hit_rate\":" << (double)hits / num_rays
+            << ",\"nodes_per_ray\":" << (double)cost.nodes / num_rays
+            << ",\"tests_per_ray\":" << (double)cost.tests / num_rays;
+    }
+    out << "}";
+    return out.str();
+}
+
 void KdTree::print_dot() {
     std::cerr << "digraph G {" << std::endl;
     for (int i = 0; i < _nodes.size(); i++) {
@@ -230,6 +444,7 @@ void KdTree::print_dot() {
 void KdTree::save(const char *filename) {
     auto f = fopen(filename, "wb");
     fwrite(&KdTreeFileMagic, sizeof(KdTreeFileMagic), 1, f);
+    fwrite(&_flags, sizeof(_flags), 1, f);
     fwrite(&_isec_cost, sizeof(_isec_cost), 1, f);
     fwrite(&_trav_cost, sizeof(_trav_cost), 1, f);
     fwrite(&_max_geoms, sizeof(_max_geoms), 1, f);
@@ -253,7 +468,9 @@ void KdTree::load(const char *filename) {
     auto f = fopen(filename, "rb");
     int magic;
     fread(&magic, sizeof(KdTreeFileMagic), 1, f);
-    if (magic != KdTreeFileMagic) {
+    if (magic == KdTreeFileMagic) {
+        fread(&_flags, sizeof(_flags), 1, f);
+    } else if (magic != KdTreeFileMagicV1) {
         std::cerr << "KdTree::load - incorrect magic number" << std::endl;
         exit(1);
     }
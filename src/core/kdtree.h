@@ -7,17 +7,66 @@
 #include <cmath>
 #include <algorithm>
 #include <functional>
+#include <memory>
+#include <string>
 
 #include "core/bbox.h"
 #include "core/math.h"
 #include "core/ray.h"
 #include "core/vector.h"
 #include "core/intersection.h"
+#include "core/memory.h"
 
 namespace gill { namespace core {
 
 const int MaxTreeSegments = 64;
-const int KdTreeFileMagic = 0xacc1;
+const int KdTreeFileMagic = 0xacc2;
+const int KdTreeFileMagicV1 = 0xacc1; /// Files without the flags field, still accepted by KdTree::load
+const uint32_t KdTreeFlagTuned = 1; /// The build parameters were chosen by KdTree::tune
+
+/**
+ * Parameters of the kD-tree construction.
+ */
+struct KdTreeParams {
+    float isec_cost; /// The computation cost of intersecting a ray with one geometry
+    float trav_cost; /// The computation cost of traversing children of a kD-tree node
+    int max_geoms; /// Max. number of geometries allowed in a leaf node.
+    int max_depth; /// Max. allowed depth of the kD-tree.
+};
+
+inline std::ostream& operator<<(std::ostream &out, const KdTreeParams &params) {
+    out << "{\"isec_cost\":" << params.isec_cost << ",\"trav_cost\":" << params.trav_cost
+        << ",\"max_geoms\":" << params.max_geoms << ",\"max_depth\":" << params.max_depth << "}";
+    return out;
+}
+
+/**
+ * Work spent by kD-tree traversals of a single thread, accumulated over all kD-trees
+ * (i.e., both the scene and the mesh accelerators). Used for traversal-cost heatmaps.
+ */
+struct TraversalCost {
+    uint64_t nodes; /// Nodes (interior and leaf) visited
+    uint64_t tests; /// Geometries tested for intersection in the visited leaves
+};
+
+/**
+ * Makes the kD-tree traversals of the calling thread add their cost to a gill::core::TraversalCost
+ * while the scope lasts. Traversals outside of such scopes (e.g., rendering without a heatmap) skip the accounting.
+ */
+class TraversalCostScope {
+public:
+    /**
+     * @param cost Receives the traversal cost, or null to disable the accounting within the scope.
+     */
+    TraversalCostScope(TraversalCost *cost);
+    ~TraversalCostScope();
+
+    TraversalCostScope(const TraversalCostScope &) = delete;
+    TraversalCostScope &operator=(const TraversalCostScope &) = delete;
+
+private:
+    TraversalCost *_previous;
+};
 
 /**
  * kD-tree for accelerating ray-to-geometry intersection tests.
@@ -112,6 +161,8 @@ class KdTree {
     float _trav_cost; /// The computation cost of traversing children of a kD-tree node
     int _max_geoms; /// Max. number of geometries allowed in a leaf node.
     int _max_depth; /// Max. allowed depth of the kD-tree.
+    size_t _build_scratch; /// Bytes of temporary buffers used while building the tree (0 if loaded from file)
+    uint32_t _flags; /// Combination of KdTreeFlag* values, stored in the cache file
     BBox _total_bounds;
     std::vector<Node> _nodes;
     std::vector<uint32_t> _geom_refs;
@@ -130,9 +181,38 @@ public:
         std::function<BBox(uint32_t)> bounds_func,
         std::function<bool(uint32_t, const Ray&, float&, Intersection*)> isec_func);
 
+    /**
+     * Builds candidate trees with different cost ratios, leaf sizes and depths (one parameter at a time,
+     * starting from the initial parameters), measures each on a fixed set of random rays
+     * crossing the geometry bounds, and returns the fastest one, flagged as tuned.
+     * @param geom_count Number of geometries.
+     * @param initial Initial parameters, used as the baseline of the search.
+     * @param num_rays Number of rays in the measured ray set.
+     * @param bounds_func Function computing bounds of a geometry.
+     * @param isec_func Function intersecting a geometry with a ray.
+     * @returns The fastest tree.
+     */
+    static std::unique_ptr<KdTree> tune(uint32_t geom_count, const KdTreeParams &initial, int num_rays,
+        std::function<BBox(uint32_t)> bounds_func,
+        std::function<bool(uint32_t, const Ray&, float&, Intersection*)> isec_func);
+
     bool intersect(const Ray &ray, float &t, Intersection *isec);
+    KdTreeParams params() const { return { _isec_cost, _trav_cost, _max_geoms, _max_depth }; }
+    bool tuned() const { return (_flags & KdTreeFlagTuned) != 0; }
     BBox bounds();
+    void memory_usage(MemoryUsage &usage) const;
     void print_info();
+
+    /**
+     * Computes quality metrics of the tree: SAH cost of the final tree (relative to the root surface),
+     * histograms of leaf depths and leaf sizes, ratio of empty leaves, the factor by which geometries are
+     * duplicated across leaves, and the average traversal work (nodes visited and geometries tested,
+     * including any nested accelerators) measured for random rays crossing the tree bounds.
+     * @param num_rays Number of random rays to trace.
+     * @param seed Seed of the random ray generator.
+     * @returns JSON object with the metrics.
+     */
+    std::string analyze(int num_rays, unsigned int seed);
     void print_dot();
     void save(const char *filename);
     void load(const char *filename);
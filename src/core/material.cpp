@@ -0,0 +1,77 @@
+#include <stdexcept>
+
+#include "core/material.h"
+
+namespace gill { namespace core {
+
+using namespace std;
+
+MaterialId MaterialTable::add(const Material *material) {
+    auto it = _ids.find(material);
+    if (it != _ids.end()) {
+        return it->second;
+    }
+    if (_materials.size() == MaxMaterials) {
+        throw std::runtime_error("too many materials");
+    }
+    MaterialId id = (MaterialId)_materials.size();
+    _materials.push_back(material->data());
+    _ids[material] = id;
+    return id;
+}
+
+#ifdef GILL_SPECTRAL
+/** Reference wavelength of the index of refraction, in micrometers. */
+const float ReferenceWavelength = 0.55f;
+#endif
+
+BSDF * MaterialTable::bsdf(MaterialId id, const SurfaceInteraction &si, SampledWavelengths &wavelengths,
+        MemoryArena &arena) const {
+    const MaterialData &data = _materials[id];
+    BSDF *bsdf = nullptr;
+    switch (data.kind) {
+    case MaterialKind::Emissive:
+        break;
+    case MaterialKind::Matte:
+        bsdf = ARENA_ALLOC(arena, BSDF)();
+        bsdf->add(ARENA_ALLOC(arena, LambertianReflection)(from_rgb(data.color, wavelengths, ColorType::Reflectance)));
+        break;
+    case MaterialKind::Mirror:
+        bsdf = ARENA_ALLOC(arena, BSDF)();
+        bsdf->add(ARENA_ALLOC(arena, SpecularReflection)(ARENA_ALLOC(arena, Fresnel)(),
+            from_rgb(data.color, wavelengths, ColorType::Reflectance)));
+        break;
+    case MaterialKind::Glass: {
+        bsdf = ARENA_ALLOC(arena, BSDF)();
+        float eta = data.eta;
+        Spectrum transmittance = from_rgb(data.color, wavelengths, ColorType::Reflectance);
+        BxDF *reflection, *transmission;
+#ifdef GILL_SPECTRAL
+        if (data.dispersion != 0.f) {
+            // Dispersion (Cauchy's equation): the direction depends on the wavelength, so only the hero
+            // wavelength follows the refracted path, carrying the contribution of the others
+            float lambda = wavelengths.lambda[0] * 1e-3f;
+            eta += data.dispersion * (1.f / (lambda * lambda) - 1.f / (ReferenceWavelength * ReferenceWavelength));
+        }
+#endif
+        Fresnel *fresnel = ARENA_ALLOC(arena, FresnelDielectric)(1.f, eta);
+        reflection = ARENA_ALLOC(arena, SpecularReflection)(fresnel, Spectrum(1.f));
+        transmission = ARENA_ALLOC(arena, SpecularTransmission)(transmittance, 1.f, eta);
+#ifdef GILL_SPECTRAL
+        if (data.dispersion != 0.f && wavelengths.terminate_secondary()) {
+            // Only at the first dispersive hit: later hits see zero secondary contributions already
+            Spectrum hero(0.f);
+            hero[0] = (float)HeroWavelengths;
+            reflection = ARENA_ALLOC(arena, ScaledBxDF)(reflection, hero);
+            transmission = ARENA_ALLOC(arena, ScaledBxDF)(transmission, hero);
+        }
+#endif
+        bsdf->add(reflection);
+        bsdf->add(transmission);
+        break;
+    }
+    }
+    return bsdf;
+}
+
+}}
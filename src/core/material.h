@@ -1,20 +1,86 @@
 #ifndef GILL_CORE_MATERIAL_H_
 #define GILL_CORE_MATERIAL_H_
 
+#include <cstdint>
+#include <map>
+#include <vector>
+
 #include "core/intersection.h"
+#include "core/memory.h"
 #include "core/spectrum.h"
 #include "core/bsdf.h"
 
 namespace gill { namespace core {
 
+/**
+ * Kinds of materials supported by the shading kernels of gill::core::MaterialTable.
+ */
+enum class MaterialKind : uint8_t {
+    Emissive,
+    Matte,
+    Mirror,
+    Glass
+};
+
+/**
+ * Flat description of a material: its kind and the parameters used by the kind's shading kernel.
+ */
+struct MaterialData {
+    MaterialKind kind;
+    float eta; /// Index of refraction at 550nm (glass)
+    float dispersion; /// Cauchy coefficient of the index of refraction, in squared micrometers (glass)
+    RGB color; /// Emission (emissive), reflectance (matte, mirror) or transmittance (glass)
+};
+
+/**
+ * Material as defined in the scene description; compiled into a gill::core::MaterialTable for rendering.
+ */
 class Material {
 public:
     virtual ~Material() {}
-    virtual BSDF * bsdf(const Intersection &isec) const = 0;
-    virtual Spectrum _emit() const { return Spectrum(0.f); }
-    virtual Spectrum _diff() const { return Spectrum(0.f); }
-    virtual Spectrum _refl() const { return Spectrum(0.f); }
-    virtual Spectrum _trsm() const { return Spectrum(0.f); }
+    virtual MaterialData data() const = 0;
+};
+
+/**
+ * Compact array of the materials used by a scene, indexed by 16-bit IDs stored with the primitives.
+ * Shading dispatches over the material kind, only for the closest hit of a ray.
+ */
+class MaterialTable {
+public:
+    /** Maximum number of distinct materials in a table. */
+    static const size_t MaxMaterials = 1 << 16;
+
+    /**
+     * Adds a material to the table, unless it is already there.
+     * @returns ID of the material.
+     */
+    MaterialId add(const Material *material);
+
+    const MaterialData& operator[](MaterialId id) const { return _materials[id]; }
+    size_t size() const { return _materials.size(); }
+
+    /**
+     * Light emitted by given material at the wavelengths carried by a path.
+     */
+    Spectrum emission(MaterialId id, const SampledWavelengths &wavelengths) const {
+        const MaterialData &data = _materials[id];
+        return data.kind == MaterialKind::Emissive ? from_rgb(data.color, wavelengths, ColorType::Illuminant) : Spectrum(0.f);
+    }
+
+    /**
+     * Creates the BSDF of given material at an intersection.
+     * @param id Material ID.
+     * @param si Surface data (in world space).
+     * @param wavelengths Wavelengths carried by the path; dispersion terminates the secondary ones.
+     * @param arena Per-thread arena the BSDF and its functions are allocated in.
+     * @returns BSDF, valid until the arena is reset; null if the surface does not scatter light.
+     */
+    BSDF * bsdf(MaterialId id, const SurfaceInteraction &si, SampledWavelengths &wavelengths,
+            MemoryArena &arena) const;
+
+protected:
+    std::vector<MaterialData> _materials;
+    std::map<const Material *, MaterialId> _ids;
 };
 
 }}
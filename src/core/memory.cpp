@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <sstream>
+
+#include "core/memory.h"
+
+namespace gill { namespace core {
+
+using namespace std;
+
+string MemoryUsage::to_json() const {
+    ostringstream out;
+    out << "{\"kdtree_nodes\":" << kdtree_nodes << ",\"kdtree_refs\":" << kdtree_refs
+        << ",\"mesh_vertices\":" << mesh_vertices << ",\"mesh_triangles\":" << mesh_triangles
+        << ",\"primitives\":" << primitives << ",\"materials\":" << materials << ",\"film_pixels\":" << film_pixels
+        << ",\"film_tiles\":" << film_tiles << ",\"filter_tables\":" << filter_tables << ",\"sampler_buffers\":" << sampler_buffers << ",\"shading_arenas\":" << shading_arenas
+        << ",\"build_scratch_peak\":" << build_scratch_peak << ",\"total\":" << total() << "}";
+    return out.str();
+}
+
+// MemoryArena methods
+
+MemoryArena::MemoryArena(size_t block_size) : _block_size(block_size), _current(nullptr), _current_size(0), _offset(0) {
+}
+
+MemoryArena::~MemoryArena() {
+    reset();
+    delete[] _current;
+    for (auto &block : _available) {
+        delete[] block.second;
+    }
+}
+
+void MemoryArena::next_block(size_t size) {
+    if (_current) {
+        _used.push_back(make_pair(_current_size, _current));
+        _current = nullptr;
+    }
+    for (auto it = _available.begin(); it != _available.end(); ++it) {
+        if (it->first >= size) {
+            _current_size = it->first;
+            _current = it->second;
+            _available.erase(it);
+            break;
+        }
+    }
+    if (!_current) {
+        _current_size = std::max(size, _block_size);
+        _current = new char[_current_size];
+    }
+    _offset = 0;
+}
+
+void MemoryArena::reset() {
+    _offset = 0;
+    _available.insert(_available.end(), _used.begin(), _used.end());
+    _used.clear();
+}
+
+size_t MemoryArena::total_allocated() const {
+    size_t total = _current_size;
+    for (auto &block : _used) {
+        total += block.first;
+    }
+    for (auto &block : _available) {
+        total += block.first;
+    }
+    return total;
+}
+
+}}
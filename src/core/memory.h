@@ -0,0 +1,102 @@
+#ifndef GILL_CORE_MEMORY_H_
+#define GILL_CORE_MEMORY_H_
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gill { namespace core {
+
+/**
+ * Bytes held by the individual subsystems of a render, for sizing render nodes.
+ * Each subsystem adds its own share via its memory_usage method; shared data (e.g., a mesh
+ * referenced by multiple primitives) is only counted once.
+ */
+struct MemoryUsage {
+    size_t kdtree_nodes = 0;
+    size_t kdtree_refs = 0;
+    size_t mesh_vertices = 0; /// Vertices and normals
+    size_t mesh_triangles = 0;
+    size_t primitives = 0; /// Primitives, including their inline transforms
+    size_t materials = 0;
+    size_t film_pixels = 0; /// Pixels, including the optional heatmap and denoiser feature channels
+    size_t filter_tables = 0;
+    size_t film_tiles = 0; /// Pixel and feature buffers of the render tiles, held while rendering
+    size_t sampler_buffers = 0;
+    size_t shading_arenas = 0; /// Initial blocks of the per-thread gill::core::MemoryArena
+    size_t build_scratch_peak = 0; /// Largest temporary allocation of a single kD-tree build (not held after the build)
+
+    /**
+     * @returns Bytes held after the scene has been built (i.e., without the build scratch).
+     */
+    size_t total() const {
+        return kdtree_nodes + kdtree_refs + mesh_vertices + mesh_triangles + primitives + materials
+            + film_pixels + film_tiles + filter_tables + sampler_buffers + shading_arenas;
+    }
+
+    std::string to_json() const;
+};
+
+
+/**
+ * Bump allocator for short-lived objects (e.g., BSDFs created at each path vertex).
+ * Memory is taken from large blocks and released all at once by MemoryArena::reset, which keeps the blocks
+ * for reuse; after the first few samples, allocations never touch the global heap.
+ * @note Destructors of the objects allocated in the arena are never called.
+ * The arena is not thread-safe; each rendering thread uses its own.
+ */
+class MemoryArena {
+public:
+    static const size_t DefaultBlockSize = 32768;
+
+    MemoryArena(size_t block_size = DefaultBlockSize);
+    MemoryArena(const MemoryArena &) = delete;
+    MemoryArena &operator=(const MemoryArena &) = delete;
+    ~MemoryArena();
+
+    /**
+     * Allocates memory aligned for any fundamental type.
+     * @param size Number of bytes.
+     */
+    void *alloc(size_t size) {
+        size = (size + Alignment - 1) & ~(Alignment - 1);
+        if (_offset + size > _current_size) {
+            next_block(size);
+        }
+        void *ptr = _current + _offset;
+        _offset += size;
+        return ptr;
+    }
+
+    /**
+     * Releases all allocations made since the last reset, keeping the blocks for reuse.
+     */
+    void reset();
+
+    /**
+     * @returns Total size of the blocks held by the arena, in bytes.
+     */
+    size_t total_allocated() const;
+
+protected:
+    static const size_t Alignment = alignof(std::max_align_t);
+
+    void next_block(size_t size);
+
+    size_t _block_size;
+    char *_current;
+    size_t _current_size, _offset;
+    std::vector<std::pair<size_t, char *>> _used, _available;
+};
+
+}}
+
+/**
+ * Constructs an object of given type in a gill::core::MemoryArena, e.g.
+ * ARENA_ALLOC(arena, LambertianReflection)(kd).
+ */
+#define ARENA_ALLOC(arena, Type) new ((arena).alloc(sizeof(Type))) Type
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef GILL_CORE_MONTECARLO_H_
 #define GILL_CORE_MONTECARLO_H_
 
+#include <algorithm>
+#include <vector>
+
 #include "core/math.h"
 #include "core/vector.h"
 
@@ -122,6 +125,57 @@ inline void triangle_sample(float u1, float u2, float& x, float& y) {
     y = u2 * tmp;
 }
 
+/**
+ * Piecewise-constant distribution over the [0,1) interval, sampled by inverting its CDF.
+ */
+class Distribution1D {
+public:
+    /**
+     * @param values Non-negative function values of n equally sized segments.
+     * @param n Number of segments.
+     */
+    Distribution1D(const float *values, int n) : _func(values, values + n), _cdf(n + 1) {
+        _cdf[0] = 0.f;
+        for (int i = 0; i < n; ++i) {
+            _cdf[i + 1] = _cdf[i] + _func[i] / n;
+        }
+        _integral = _cdf[n];
+        for (int i = 1; i <= n; ++i) {
+            _cdf[i] = _integral > 0.f ? _cdf[i] / _integral : float(i) / n;
+        }
+    }
+
+    /**
+     * Converts a random value into a sample of the distribution.
+     * @param u Random value, uniformly sampled from [0,1) interval.
+     * @param pdf Probability density of the sample (optional).
+     * @param offset Index of the segment containing the sample (optional).
+     * @returns Sample from [0,1) interval.
+     */
+    float sample(float u, float *pdf = nullptr, int *offset = nullptr) const {
+        int i = std::max(0, std::min(count() - 1, int(std::upper_bound(_cdf.begin(), _cdf.end(), u) - _cdf.begin()) - 1));
+        float du = u - _cdf[i];
+        if (_cdf[i + 1] > _cdf[i]) {
+            du /= _cdf[i + 1] - _cdf[i];
+        }
+        if (pdf) {
+            *pdf = _integral > 0.f ? _func[i] / _integral : 0.f;
+        }
+        if (offset) {
+            *offset = i;
+        }
+        return (i + du) / count();
+    }
+
+    int count() const { return (int)_func.size(); }
+    float integral() const { return _integral; }
+    size_t memory_usage() const { return (_func.size() + _cdf.size()) * sizeof(float); }
+
+protected:
+    std::vector<float> _func, _cdf;
+    float _integral;
+};
+
 }}
 
 #endif
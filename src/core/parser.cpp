@@ -1,8 +1,12 @@
 #include <cassert>
+#include <cstring>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 
 #include "core/parser.h"
+#include "core/perf.h"
+#include "core/trace.h"
 #include "geometry/mesh.h"
 #include "geometry/sphere.h"
 #include "geometry/plane.h"
@@ -13,6 +17,7 @@
 #include "filter/triangle.h"
 #include "filter/gaussian.h"
 #include "filter/mitchell.h"
+#include "denoiser/atrous.h"
 #include "material/matte.h"
 #include "material/emissive.h"
 #include "material/mirror.h"
@@ -24,12 +29,32 @@ namespace gill { namespace core {
 using namespace std;
 using namespace gill::camera;
 using namespace gill::filter;
+using namespace gill::denoiser;
 using namespace gill::geometry;
 using namespace gill::material;
 using namespace gill::renderer;
 using namespace gill::sampler;
 using namespace gill::integrator;
 
+/** Default memory budget (in MB) for baking instanced meshes into world space. */
+const float DefaultFlattenBudget = 64.0;
+/** Estimated accelerator memory (kD-tree nodes and geometry refs) per baked triangle, in bytes. */
+const size_t AcceleratorBytesPerFace = 32;
+/**
+ * Minimum number of primitives for tuning the scene accelerator. Unlike mesh accelerators, it is not cached,
+ * and for a handful of primitives the search would cost more than it could save.
+ */
+const size_t MinTunedPrimitives = 64;
+/**
+ * Keys of the progressive rendering settings (as a section and as overrides), which may change between the runs
+ * of a render resumed from a checkpoint, and are thus left out of the document hash.
+ */
+const set<string> ProgressiveKeys = { "progressive", "pass_spp", "time_budget", "target_noise", "checkpoint",
+    "checkpoint_interval" };
+/** Keys accepted by Parser::set_overrides. */
+const set<string> OverrideKeys = { "spp", "fov", "position", "target", "up", "pass_spp", "time_budget",
+    "target_noise", "checkpoint", "checkpoint_interval" };
+
 bool file_exists(const string &filename) {
     auto f = fopen(filename.c_str(), "r");
     if (f) {
@@ -40,15 +65,14 @@ bool file_exists(const string &filename) {
     }
 }
 
-Parser::Parser() {
+Parser::Parser() : _input(nullptr) {
     yaml_parser_initialize(&_parser);
     yaml_parser_set_input_file(&_parser, stdin);
 }
 
-Parser::Parser(const char *filename) {
+Parser::Parser(const char *filename) : _input(nullptr) {
     yaml_parser_initialize(&_parser);
-    _input = fopen(filename, "r");
-    yaml_parser_set_input_file(&_parser, _input);
+    open(filename);
 }
 
 Parser::~Parser() {
@@ -58,18 +82,89 @@ Parser::~Parser() {
     }
 }
 
+void Parser::open(const char *filename) {
+    yaml_parser_delete(&_parser);
+    yaml_parser_initialize(&_parser);
+    _transforms.clear();
+    _geometries.clear();
+    _materials.clear();
+    if (_input) {
+        fclose(_input);
+    }
+    _input = fopen(filename, "r");
+    if (!_input) {
+        throw std::runtime_error("cannot open scene file");
+    }
+    yaml_parser_set_input_file(&_parser, _input);
+}
+
+void Parser::set_overrides(const map<string, string> &overrides) {
+    for (auto &item : overrides) {
+        if (!OverrideKeys.count(item.first)) {
+            throw std::runtime_error("unknown override " + item.first);
+        }
+    }
+    _overrides = overrides;
+}
+
+template <typename T>
+bool Parser::_get_override(const string &key, T &value) {
+    auto item = _overrides.find(key);
+    if (item == _overrides.end()) {
+        return false;
+    }
+    stringstream stream(item->second);
+    stream >> value;
+    return true;
+}
+
+template <>
+bool Parser::_get_override(const string &key, Vector &value) {
+    auto item = _overrides.find(key);
+    if (item == _overrides.end()) {
+        return false;
+    }
+    string str = item->second;
+    std::replace(str.begin(), str.end(), ',', ' ');
+    stringstream stream(str);
+    stream >> value.x >> value.y >> value.z;
+    return true;
+}
+
 shared_ptr<Parser::Document> Parser::next_document() {
+    PerfScope scope("parse");
+    TraceScope trace("parse_document", "parse");
     yaml_parser_load(&_parser, &_document);
-    yaml_node_t *root = yaml_document_get_root_node(&_document);
     shared_ptr<Parser::Document> doc = nullptr;
-    if (root) {
-        doc = parse_document(root);
+    try {
+        yaml_node_t *root = yaml_document_get_root_node(&_document);
+        if (root) {
+            doc = parse_document(root);
+        }
+    } catch (...) {
+        // The parser may be reused (e.g., by the render server) after an invalid document
+        close_document();
+        throw;
     }
+    close_document();
+    return doc;
+}
+
+void Parser::close_document() {
+    // Node-indexed caches are only valid within a single document;
+    // loaded meshes are kept in _meshes and _flattened_meshes for the following documents
     _transforms.clear();
     _geometries.clear();
     _materials.clear();
+    // Baked meshes no longer referenced by any scene would otherwise accumulate in animations
+    for (auto it = _flattened_meshes.begin(); it != _flattened_meshes.end();) {
+        if (it->second.use_count() == 1) {
+            it = _flattened_meshes.erase(it);
+        } else {
+            ++it;
+        }
+    }
     yaml_document_delete(&_document);
-    return doc;
 }
 
 shared_ptr<Parser::Document> Parser::parse_document(yaml_node_t *node) {
@@ -87,12 +182,59 @@ shared_ptr<Parser::Document> Parser::parse_document(yaml_node_t *node) {
 shared_ptr<Scene> Parser::parse_scene(yaml_node_t *node) {
     assert(node->type == YAML_MAPPING_NODE);
     vector<Primitive> primitives;
-    _traverse_mapping(node, [this, &primitives](string &key, yaml_node_t *value) {
+    float flatten_budget = DefaultFlattenBudget;
+    int autotune = 0;
+    _traverse_mapping(node, [this, &primitives, &flatten_budget, &autotune](string &key, yaml_node_t *value) {
         if (key == "primitives") {
             primitives = parse_primitives(value);
+        } else if (key == "flatten_budget") {
+            flatten_budget = _get_scalar<float>(value);
+        } else if (key == "autotune") {
+            autotune = _get_scalar<int>(value);
         }
     });
-    return make_shared<Scene>(primitives);
+    if (autotune > 0) {
+        // Tuned before flattening, so that baked meshes inherit the tuned parameters
+        tune_accelerators(primitives, autotune);
+    }
+    auto scene = make_shared<Scene>(flatten_instances(primitives, flatten_budget));
+    if (autotune > 0 && scene->primitives().size() >= MinTunedPrimitives) {
+        scene->tune_accelerator(autotune);
+        cerr << "autotune:[scene, " << scene->accelerator()->params() << "]" << endl;
+    }
+    return scene;
+}
+
+/**
+ * Replaces meshes that have not been tuned yet by copies with tuned accelerators (see gill::geometry::Mesh::from_tuned),
+ * both in the primitives and in the registry, and stores them in the mesh cache so that the search is done only once
+ * per asset. The original meshes are not modified, since documents parsed before (e.g., rendered in a pipeline)
+ * may still be using them.
+ */
+void Parser::tune_accelerators(vector<Primitive> &primitives, int num_rays) {
+    for (auto &asset : _meshes) {
+        auto mesh = dynamic_pointer_cast<Mesh>(asset.second);
+        if (!mesh || mesh->accelerator()->tuned()) {
+            continue;
+        }
+        bool used = false;
+        for (auto &p : primitives) {
+            used = used || p.geometry() == asset.second;
+        }
+        if (used) {
+            auto tuned = Mesh::from_tuned(*mesh, num_rays);
+            for (auto &p : primitives) {
+                if (p.geometry() == asset.second) {
+                    p.set_geometry(tuned);
+                }
+            }
+            asset.second = tuned;
+            tuned->save_cache(asset.first.c_str());
+            ostringstream report;
+            report << "autotune:[" << asset.first << ", " << tuned->accelerator()->params() << "]" << endl;
+            cerr << report.str();
+        }
+    }
 }
 
 vector<Primitive> Parser::parse_primitives(yaml_node_t *node) {
@@ -103,6 +245,73 @@ vector<Primitive> Parser::parse_primitives(yaml_node_t *node) {
     return primitives;
 }
 
+/**
+ * Bakes mesh instances sharing the same geometry and material into a single world-space mesh
+ * when the baked copy fits the memory budget, removing the transformation and the second-level
+ * kD-tree walk from the intersection path. Other primitives are kept as they are.
+ * @param primitives Parsed scene primitives.
+ * @param budget Maximum memory (in MB) a single baked mesh may occupy.
+ * @returns Primitives of the scene, with baked instances merged into one primitive each.
+ */
+vector<Primitive> Parser::flatten_instances(const vector<Primitive> &primitives, float budget) {
+    TraceScope trace("flatten_instances", "build");
+    typedef pair<Geometry *, Material *> InstanceKey;
+    map<InstanceKey, vector<int>> groups;
+    for (int i = 0; i < (int)primitives.size(); ++i) {
+        const Primitive &prim = primitives[i];
+        if (dynamic_pointer_cast<Mesh>(prim.geometry())) {
+            groups[InstanceKey(prim.geometry().get(), prim.material().get())].push_back(i);
+        }
+    }
+
+    vector<Primitive> result;
+    map<InstanceKey, bool> flattened;
+    for (int i = 0; i < (int)primitives.size(); ++i) {
+        const Primitive &prim = primitives[i];
+        auto mesh = dynamic_pointer_cast<Mesh>(prim.geometry());
+        if (!mesh) {
+            result.push_back(prim);
+            continue;
+        }
+
+        InstanceKey key(prim.geometry().get(), prim.material().get());
+        const vector<int> &group = groups[key];
+        if (group[0] == i) {
+            size_t bytes = group.size() * (mesh->num_vertices() * sizeof(Point)
+                + mesh->num_faces() * (sizeof(Mesh::Triangle) + AcceleratorBytesPerFace));
+            float mbytes = bytes / (1024.0 * 1024.0);
+            flattened[key] = group.size() > 1 && mbytes <= budget;
+            ostringstream report;
+            report << "instancing:[" << mesh->num_faces() << " faces x " << group.size() << " instances, "
+                << mbytes << "MB, " << (flattened[key] ? "flattened" : "instanced");
+            if (flattened[key]) {
+                vector<AffineTransform> ltows, wtols;
+                ostringstream baked_key;
+                baked_key.precision(9);
+                baked_key << mesh.get();
+                for (int j : group) {
+                    ltows.push_back(primitives[j].local_to_world());
+                    wtols.push_back(primitives[j].world_to_local());
+                    baked_key << ltows.back();
+                }
+                shared_ptr<Geometry> &baked = _flattened_meshes[baked_key.str()];
+                if (baked) {
+                    report << ", reused";
+                } else {
+                    baked = Mesh::from_instances(*mesh, ltows, wtols);
+                }
+                result.push_back(Primitive(baked, prim.material(), make_shared<Transform>(), make_shared<Transform>()));
+            }
+            report << "]" << endl;
+            cerr << report.str();
+        }
+        if (!flattened[key]) {
+            result.push_back(prim);
+        }
+    }
+    return result;
+}
+
 Primitive Parser::parse_primitive(yaml_node_t *node) {
     shared_ptr<Geometry> geometry = nullptr;
     shared_ptr<Material> material = nullptr;
@@ -136,10 +345,20 @@ shared_ptr<Geometry> Parser::parse_geometry(yaml_node_t *node) {
                 url = _get_scalar<string>(value);
             }
         });
-        if (file_exists(url + ".mesh") && file_exists(url + ".kdtree")) {
-            geometry = Mesh::from_cache_file(url.c_str());
+        auto asset = _meshes.find(url);
+        if (asset != _meshes.end()) {
+            geometry = asset->second;
         } else {
-            geometry = Mesh::from_obj_file(url.c_str());
+            TraceScope trace("load_mesh", "parse");
+            trace.arg("url", url);
+            if (file_exists(url + ".mesh") && file_exists(url + ".kdtree")) {
+                trace.arg("source", "cache");
+                geometry = Mesh::from_cache_file(url.c_str());
+            } else {
+                trace.arg("source", "obj");
+                geometry = Mesh::from_obj_file(url.c_str());
+            }
+            _meshes.insert(pair<string, shared_ptr<Geometry>>(url, geometry));
         }
     } else if (tag == "!sphere") {
         float radius = 1.0;
@@ -171,38 +390,43 @@ shared_ptr<Material> Parser::parse_material(yaml_node_t *node) {
     shared_ptr<Material> material = nullptr;
     string tag((char *)node->tag);
     if (tag == "!matte") {
-        Spectrum color(0.0, 0.0, 0.0);
+        RGB color(0.0, 0.0, 0.0);
         _traverse_mapping(node, [this, &color](string &key, yaml_node_t *value) {
             if (key == "color") {
                 auto seq = _get_sequence<float, 3>(value);
-                color = Spectrum(seq[0], seq[1], seq[2]);
+                color = RGB(seq[0], seq[1], seq[2]);
             }
         });
         material = make_shared<MatteMaterial>(color);
     } else if (tag == "!mirror") {
-        Spectrum color(0.0, 0.0, 0.0);
+        RGB color(0.0, 0.0, 0.0);
         _traverse_mapping(node, [this, &color](string &key, yaml_node_t *value) {
             if (key == "color") {
                 auto seq = _get_sequence<float, 3>(value);
-                color = Spectrum(seq[0], seq[1], seq[2]);
+                color = RGB(seq[0], seq[1], seq[2]);
             }
         });
         material = make_shared<MirrorMaterial>(color);
     } else if (tag == "!glass") {
-        Spectrum color(0.0, 0.0, 0.0);
-        _traverse_mapping(node, [this, &color](string &key, yaml_node_t *value) {
+        RGB color(0.0, 0.0, 0.0);
+        float eta = 1.5f, dispersion = 0.f;
+        _traverse_mapping(node, [this, &color, &eta, &dispersion](string &key, yaml_node_t *value) {
             if (key == "color") {
                 auto seq = _get_sequence<float, 3>(value);
-                color = Spectrum(seq[0], seq[1], seq[2]);
+                color = RGB(seq[0], seq[1], seq[2]);
+            } else if (key == "eta") {
+                eta = _get_scalar<float>(value);
+            } else if (key == "dispersion") {
+                dispersion = _get_scalar<float>(value);
             }
         });
-        material = make_shared<GlassMaterial>(color);
+        material = make_shared<GlassMaterial>(color, eta, dispersion);
     } else if (tag == "!emissive") {
-        Spectrum color(0.0, 0.0, 0.0);
+        RGB color(0.0, 0.0, 0.0);
         _traverse_mapping(node, [this, &color](string &key, yaml_node_t *value) {
             if (key == "color") {
                 auto seq = _get_sequence<float, 3>(value);
-                color = Spectrum(seq[0], seq[1], seq[2]);
+                color = RGB(seq[0], seq[1], seq[2]);
             }
         });
         material = make_shared<EmissiveMaterial>(color);
@@ -300,7 +524,8 @@ shared_ptr<Renderer> Parser::parse_renderer(yaml_node_t *node) {
         shared_ptr<Sampler> sampler = nullptr;
         shared_ptr<SurfaceIntegrator> surf_integrator = nullptr;
         int thread_tiles[2] = {1, 1};
-        _traverse_mapping(node, [this, &camera, &sampler, &surf_integrator, &thread_tiles](string &key, yaml_node_t *value) {
+        ProgressiveOptions progressive;
+        _traverse_mapping(node, [this, &camera, &sampler, &surf_integrator, &thread_tiles, &progressive](string &key, yaml_node_t *value) {
             if (key == "camera") {
                 camera = parse_camera(value);
             } else if (key == "sampler") {
@@ -311,9 +536,37 @@ shared_ptr<Renderer> Parser::parse_renderer(yaml_node_t *node) {
                 auto seq = _get_sequence<int, 2>(value);
                 thread_tiles[0] = seq[0];
                 thread_tiles[1] = seq[1];
+            } else if (key == "progressive") {
+                _traverse_mapping(value, [this, &progressive](string &key, yaml_node_t *value) {
+                    if (key == "pass_spp") {
+                        progressive.pass_spp = _get_scalar<int>(value);
+                    } else if (key == "time_budget") {
+                        progressive.time_budget = _get_scalar<double>(value);
+                    } else if (key == "target_noise") {
+                        progressive.target_noise = _get_scalar<float>(value);
+                    } else if (key == "checkpoint") {
+                        progressive.checkpoint = _get_scalar<string>(value);
+                    } else if (key == "checkpoint_interval") {
+                        progressive.checkpoint_interval = _get_scalar<double>(value);
+                    }
+                });
             }
         });
-        return make_shared<SampledRenderer>(camera, surf_integrator, sampler, thread_tiles);
+        _get_override("pass_spp", progressive.pass_spp);
+        _get_override("time_budget", progressive.time_budget);
+        _get_override("target_noise", progressive.target_noise);
+        _get_override("checkpoint", progressive.checkpoint);
+        _get_override("checkpoint_interval", progressive.checkpoint_interval);
+        progressive.document_hash = document_hash();
+        if (progressive.pass_spp < 0) {
+            throw std::runtime_error("pass_spp must not be negative");
+        }
+        // Stopping early or resuming needs passes
+        if (progressive.pass_spp == 0 && (progressive.time_budget > 0.0 || progressive.target_noise > 0.f
+                || !progressive.checkpoint.empty())) {
+            progressive.pass_spp = 1;
+        }
+        return make_shared<SampledRenderer>(camera, surf_integrator, sampler, thread_tiles, progressive);
     }
     throw std::runtime_error("unknown renderer type");
 }
@@ -327,6 +580,7 @@ shared_ptr<Sampler> Parser::parse_sampler(yaml_node_t *node) {
                 spp = _get_scalar<int>(value);
             }
         });
+        _get_override("spp", spp);
         return make_shared<StratifiedSampler>(0, 511, 0, 511, spp);
     }
     throw std::runtime_error("unknown sampler type");
@@ -367,6 +621,16 @@ shared_ptr<Camera> Parser::parse_camera(yaml_node_t *node) {
                 film = parse_film(value);
             }
         });
+        _get_override("fov", field_of_view);
+        Vector position, target, up(0.0, 1.0, 0.0);
+        bool has_position = _get_override("position", position);
+        bool has_target = _get_override("target", target);
+        _get_override("up", up);
+        if (has_position != has_target) {
+            throw std::runtime_error("camera override requires both position and target");
+        } else if (has_position) {
+            transform = Transform::look_at(position, target, up);
+        }
         return make_shared<PerspectiveCamera>(transform, film, field_of_view, lens_radius, focal_distance);
     }
     throw std::runtime_error("unknown camera type");
@@ -375,16 +639,31 @@ shared_ptr<Camera> Parser::parse_camera(yaml_node_t *node) {
 shared_ptr<Film> Parser::parse_film(yaml_node_t *node) {
     int xres = 0, yres = 0;
     shared_ptr<Filter> filter = nullptr;
-    _traverse_mapping(node, [this, &xres, &yres, &filter](string &key, yaml_node_t *value) {
+    string filter_sampling = "splat";
+    shared_ptr<Denoiser> denoiser = nullptr;
+    _traverse_mapping(node, [this, &xres, &yres, &filter, &filter_sampling, &denoiser](string &key, yaml_node_t *value) {
         if (key == "resolution") {
             auto seq = _get_sequence<int, 2>(value);
             xres = seq[0];
             yres = seq[1];
         } else if (key == "filter") {
             filter = parse_filter(value);
+        } else if (key == "filter_sampling") {
+            filter_sampling = _get_scalar<string>(value);
+        } else if (key == "denoiser") {
+            denoiser = parse_denoiser(value);
         }
     });
-    return make_shared<Film>(xres, yres, filter);
+    auto film = make_shared<Film>(xres, yres, filter);
+    if (filter_sampling == "importance") {
+        film->enable_filter_sampling();
+    } else if (filter_sampling != "splat") {
+        throw std::runtime_error("unknown filter sampling mode " + filter_sampling);
+    }
+    if (denoiser) {
+        film->set_denoiser(denoiser);
+    }
+    return film;
 }
 
 shared_ptr<Filter> Parser::parse_filter(yaml_node_t *node) {
@@ -438,6 +717,81 @@ shared_ptr<Filter> Parser::parse_filter(yaml_node_t *node) {
     throw std::runtime_error("unknown filter type");
 }
 
+shared_ptr<Denoiser> Parser::parse_denoiser(yaml_node_t *node) {
+    string tag((char *)node->tag);
+    if (tag == "!atrous") {
+        int iterations = 5, threads = 0;
+        float sigma_luminance = 4.f, sigma_normal = 128.f, sigma_depth = 1.f, sigma_albedo = 0.1f;
+        _traverse_mapping(node, [this, &iterations, &sigma_luminance, &sigma_normal, &sigma_depth, &sigma_albedo, &threads](string &key, yaml_node_t *value) {
+            if (key == "iterations") {
+                iterations = _get_scalar<int>(value);
+            } else if (key == "sigma_luminance") {
+                sigma_luminance = _get_scalar<float>(value);
+            } else if (key == "sigma_normal") {
+                sigma_normal = _get_scalar<float>(value);
+            } else if (key == "sigma_depth") {
+                sigma_depth = _get_scalar<float>(value);
+            } else if (key == "sigma_albedo") {
+                sigma_albedo = _get_scalar<float>(value);
+            } else if (key == "threads") {
+                threads = _get_scalar<int>(value);
+            }
+        });
+        return make_shared<AtrousDenoiser>(iterations, sigma_luminance, sigma_normal, sigma_depth, sigma_albedo, threads);
+    }
+    throw std::runtime_error("unknown denoiser type");
+}
+
+/**
+ * FNV-1a hash of a string, continuing from a previous hash.
+ */
+uint64_t hash_string(const char *str, size_t length, uint64_t hash) {
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ (unsigned char)str[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t Parser::document_hash() {
+    uint64_t hash = 14695981039346656037ull;
+    yaml_node_t *root = yaml_document_get_root_node(&_document);
+    if (root) {
+        hash = _hash_node(root, hash);
+    }
+    for (auto &item : _overrides) {
+        if (!ProgressiveKeys.count(item.first)) {
+            hash = hash_string(item.first.c_str(), item.first.size() + 1, hash);
+            hash = hash_string(item.second.c_str(), item.second.size() + 1, hash);
+        }
+    }
+    return hash;
+}
+
+uint64_t Parser::_hash_node(yaml_node_t *node, uint64_t hash) {
+    hash = hash_string((const char *)&node->type, sizeof(node->type), hash);
+    if (node->tag) {
+        hash = hash_string((const char *)node->tag, strlen((const char *)node->tag) + 1, hash);
+    }
+    if (node->type == YAML_SCALAR_NODE) {
+        hash = hash_string((const char *)node->data.scalar.value, node->data.scalar.length, hash);
+    } else if (node->type == YAML_SEQUENCE_NODE) {
+        _traverse_sequence(node, [this, &hash](yaml_node_t *item) {
+            hash = _hash_node(item, hash);
+        });
+    } else if (node->type == YAML_MAPPING_NODE) {
+        auto map = node->data.mapping;
+        for (auto *item = map.pairs.start; item != map.pairs.top; ++item) {
+            auto knode = yaml_document_get_node(&_document, item->key);
+            if (knode->type == YAML_SCALAR_NODE && ProgressiveKeys.count(_get_scalar<string>(knode))) {
+                continue;
+            }
+            hash = _hash_node(knode, hash);
+            hash = _hash_node(yaml_document_get_node(&_document, item->value), hash);
+        }
+    }
+    return hash;
+}
+
 void Parser::_traverse_mapping(yaml_node_t *node, function<void(std::string&, yaml_node_t*)> func) {
     assert(node->type == YAML_MAPPING_NODE);
     auto map = node->data.mapping;
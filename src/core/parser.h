@@ -4,6 +4,7 @@
 #include <yaml.h>
 #include <vector>
 #include <map>
+#include <string>
 #include <functional>
 
 #include "core/camera.h"
@@ -33,6 +34,23 @@ public:
     ~Parser();
     std::shared_ptr<Document> next_document();
 
+    /**
+     * Switches the parser to another input file.
+     * Loaded meshes and their accelerators are kept and shared with the documents of the new file.
+     * @param filename Path to the YAML scene description.
+     */
+    void open(const char *filename);
+
+    /**
+     * Sets values overriding the parsed scene description, for example in render jobs.
+     * Supported keys are 'spp' (samples per pixel), 'fov' (camera field of view), and 'position',
+     * 'target' and 'up' (camera look-at transform, vectors formatted as 'x,y,z'), and the progressive rendering
+     * settings 'pass_spp', 'time_budget', 'target_noise', 'checkpoint' and 'checkpoint_interval'.
+     * @param overrides Map of override keys and values.
+     * @throws std::runtime_error for an unknown key (the previous overrides are kept).
+     */
+    void set_overrides(const std::map<std::string, std::string> &overrides);
+
 protected:
     FILE *_input;
     yaml_parser_t _parser;
@@ -42,9 +60,22 @@ protected:
     std::map<int, std::shared_ptr<Geometry>> _geometries;
     std::map<int, std::shared_ptr<Material>> _materials;
 
+    /// Loaded meshes (including their accelerators), keyed by URL; shared by all parsed documents
+    std::map<std::string, std::shared_ptr<Geometry>> _meshes;
+    /// Meshes baked from instances, keyed by source mesh and instance transforms; shared by all parsed documents
+    std::map<std::string, std::shared_ptr<Geometry>> _flattened_meshes;
+    std::map<std::string, std::string> _overrides;
+
+    /**
+     * Releases the current YAML document and the caches indexed by its nodes; called after each document,
+     * whether it was parsed successfully or not.
+     */
+    void close_document();
     std::shared_ptr<Document> parse_document(yaml_node_t *node);
     std::shared_ptr<Scene> parse_scene(yaml_node_t *node);
     std::vector<Primitive> parse_primitives(yaml_node_t *node);
+    std::vector<Primitive> flatten_instances(const std::vector<Primitive> &primitives, float budget);
+    void tune_accelerators(std::vector<Primitive> &primitives, int num_rays);
     Primitive parse_primitive(yaml_node_t *node);
     std::shared_ptr<Geometry> parse_geometry(yaml_node_t *node);
     std::shared_ptr<Material> parse_material(yaml_node_t *node);
@@ -55,11 +86,19 @@ protected:
     std::shared_ptr<SurfaceIntegrator> parse_surface_integrator(yaml_node_t *node);
     std::shared_ptr<Film> parse_film(yaml_node_t *node);
     std::shared_ptr<Filter> parse_filter(yaml_node_t *node);
+    std::shared_ptr<Denoiser> parse_denoiser(yaml_node_t *node);
 
+    /**
+     * @returns Hash of the current document (without the progressive rendering settings) and the overrides,
+     * identifying a render whose checkpoint can be resumed.
+     */
+    uint64_t document_hash();
+    uint64_t _hash_node(yaml_node_t *node, uint64_t hash);
     void _traverse_mapping(yaml_node_t *node, std::function<void(std::string&, yaml_node_t*)> func);
     void _traverse_sequence(yaml_node_t *node, std::function<void(yaml_node_t*)> func);
     template <typename T> T _get_scalar(yaml_node_t *node);
     template <typename T, int size> std::vector<T> _get_sequence(yaml_node_t *node);
+    template <typename T> bool _get_override(const std::string &key, T &value);
 };
 
 }}
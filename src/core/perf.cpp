@@ -0,0 +1,238 @@
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include "core/perf.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace gill { namespace core {
+
+const char *PerfEventNames[NumPerfEvents] = {
+    "cycles", "instructions", "l1d_misses", "cache_misses", "branch_misses"
+};
+
+#ifdef __linux__
+
+static int open_event(PerfEvent event) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    switch (event) {
+    case PerfCycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PerfInstructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PerfL1DMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case PerfCacheMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case PerfBranchMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    default:
+        return -1;
+    }
+    // Count the calling thread only, on any CPU
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PerfCounters::PerfCounters() {
+    for (int i = 0; i < NumPerfEvents; ++i) {
+        _fds[i] = open_event((PerfEvent)i);
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int i = 0; i < NumPerfEvents; ++i) {
+        if (_fds[i] >= 0) {
+            close(_fds[i]);
+        }
+    }
+}
+
+void PerfCounters::start() {
+    for (int i = 0; i < NumPerfEvents; ++i) {
+        if (_fds[i] >= 0) {
+            ioctl(_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop() {
+    for (int i = 0; i < NumPerfEvents; ++i) {
+        if (_fds[i] >= 0) {
+            ioctl(_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+}
+
+uint64_t PerfCounters::value(PerfEvent event) const {
+    uint64_t count = 0;
+    if (_fds[event] < 0 || read(_fds[event], &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    return count;
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+    for (int i = 0; i < NumPerfEvents; ++i) {
+        _fds[i] = -1;
+    }
+}
+
+PerfCounters::~PerfCounters() {}
+
+void PerfCounters::start() {}
+
+void PerfCounters::stop() {}
+
+uint64_t PerfCounters::value(PerfEvent event) const {
+    return 0;
+}
+
+#endif
+
+/** Totals of a single phase. */
+struct PerfPhase {
+    int threads = 0;
+    double time = 0.0;
+    uint64_t values[NumPerfEvents] = {};
+    bool available[NumPerfEvents] = { true, true, true, true, true };
+};
+
+static bool perf_enabled = false;
+static std::mutex perf_mutex;
+static std::map<std::string, PerfPhase> perf_phases;
+
+void PerfCounters::set_enabled(bool enabled) {
+    perf_enabled = enabled;
+}
+
+bool PerfCounters::enabled() {
+    return perf_enabled;
+}
+
+PerfCounters& PerfCounters::thread_counters() {
+    // The counters are released when the thread exits
+    thread_local PerfCounters counters;
+    thread_local bool started = false;
+    if (!started) {
+        counters.start();
+        started = true;
+    }
+    return counters;
+}
+
+/** Innermost scope of the calling thread. */
+static thread_local PerfScope *current_scope = nullptr;
+
+PerfScope::PerfScope(const char *phase) : _phase(phase), _parent(nullptr), _totals(), _time(0.0) {
+    if (!perf_enabled) {
+        return;
+    }
+    _parent = current_scope;
+    if (_parent) {
+        _parent->pause();
+    }
+    current_scope = this;
+    resume();
+}
+
+PerfScope::~PerfScope() {
+    // Scopes entered while the counters were disabled are not tracked
+    if (current_scope != this) {
+        return;
+    }
+    pause();
+    current_scope = _parent;
+    if (_parent) {
+        _parent->resume();
+    }
+    PerfCounters &counters = PerfCounters::thread_counters();
+    std::lock_guard<std::mutex> lock(perf_mutex);
+    PerfPhase &phase = perf_phases[_phase];
+    phase.threads++;
+    phase.time += _time;
+    for (int i = 0; i < NumPerfEvents; ++i) {
+        phase.values[i] += _totals[i];
+        phase.available[i] = phase.available[i] && counters.available((PerfEvent)i);
+    }
+}
+
+void PerfScope::pause() {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - _begin_time;
+    _time += elapsed.count();
+    PerfCounters &counters = PerfCounters::thread_counters();
+    for (int i = 0; i < NumPerfEvents; ++i) {
+        _totals[i] += counters.value((PerfEvent)i) - _values[i];
+    }
+}
+
+void PerfScope::resume() {
+    PerfCounters &counters = PerfCounters::thread_counters();
+    for (int i = 0; i < NumPerfEvents; ++i) {
+        _values[i] = counters.value((PerfEvent)i);
+    }
+    _begin_time = std::chrono::high_resolution_clock::now();
+}
+
+std::string perf_report() {
+    std::lock_guard<std::mutex> lock(perf_mutex);
+    std::ostringstream out;
+    out << "{";
+    for (auto it = perf_phases.begin(); it != perf_phases.end(); ++it) {
+        const PerfPhase &phase = it->second;
+        out << (it == perf_phases.begin() ? "" : ",") << "\"" << it->first << "\":{";
+        out << "\"threads\":" << phase.threads << ",\"time_ms\":" << phase.time;
+        for (int i = 0; i < NumPerfEvents; ++i) {
+            out << ",\"" << PerfEventNames[i] << "\":";
+            if (phase.available[i]) {
+                out << phase.values[i];
+            } else {
+                out << "null";
+            }
+        }
+        out << "}";
+    }
+    out << "}";
+    return out.str();
+}
+
+void perf_reset() {
+    std::lock_guard<std::mutex> lock(perf_mutex);
+    perf_phases.clear();
+}
+
+bool PerfCounters::available() const {
+    for (int i = 0; i < NumPerfEvents; ++i) {
+        if (_fds[i] >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}}
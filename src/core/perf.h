@@ -0,0 +1,124 @@
+#ifndef GILL_CORE_PERF_H_
+#define GILL_CORE_PERF_H_
+
+#include <cstdint>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace gill { namespace core {
+
+/**
+ * Hardware events that can be counted by gill::core::PerfCounters.
+ */
+enum PerfEvent {
+    PerfCycles,
+    PerfInstructions,
+    PerfL1DMisses,
+    PerfCacheMisses,
+    PerfBranchMisses,
+    NumPerfEvents
+};
+
+/** Names of the hardware events, as used in the stats output. */
+extern const char *PerfEventNames[NumPerfEvents];
+
+/**
+ * Hardware performance counters of the calling thread, based on Linux perf_event_open.
+ * Every event is opened separately, so the events that are not supported or not permitted
+ * (e.g., in virtual machines, or with restrictive perf_event_paranoid settings) are simply
+ * reported as unavailable, and on other platforms no counters are available at all.
+ */
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * Resets the counters and starts counting.
+     */
+    void start();
+
+    /**
+     * Stops counting, keeping the values accumulated since the last start().
+     */
+    void stop();
+
+    /**
+     * @returns True if at least one of the events can be counted.
+     */
+    bool available() const;
+
+    /**
+     * @returns True if given event can be counted.
+     */
+    bool available(PerfEvent event) const {
+        return _fds[event] >= 0;
+    }
+
+    /**
+     * @returns Value of given counter, or zero if the event is not available.
+     */
+    uint64_t value(PerfEvent event) const;
+
+    /**
+     * Enables or disables the collection of counters in gill::core::PerfScope (disabled by default).
+     */
+    static void set_enabled(bool enabled);
+    static bool enabled();
+
+    /**
+     * @returns Counters of the calling thread, opened and started on first use.
+     */
+    static PerfCounters& thread_counters();
+
+protected:
+    int _fds[NumPerfEvents];
+};
+
+/**
+ * Scope of a named phase (e.g., "parse", "build", "render" or "output") whose hardware counters
+ * and time are added to the process-wide totals of the phase when the scope ends.
+ * Each thread counts its own events, so a phase may be entered by multiple threads concurrently
+ * (e.g., by all render tiles). Phases may be nested: the enclosing scope of the same thread is paused
+ * while a nested one runs, so each phase only counts its exclusive time and events (e.g., the parse
+ * phase does not include the builds it triggers).
+ * @note When the counters are not enabled, the scope does nothing.
+ */
+class PerfScope {
+public:
+    PerfScope(const char *phase);
+    ~PerfScope();
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+protected:
+    /** Adds the time and events since the scope was (re)started to its totals. */
+    void pause();
+    void resume();
+
+    const char *_phase;
+    PerfScope *_parent; /// Enclosing scope of the same thread, if any
+    uint64_t _values[NumPerfEvents]; /// Counter values when the scope was (re)started
+    uint64_t _totals[NumPerfEvents];
+    double _time;
+    std::chrono::high_resolution_clock::time_point _begin_time;
+};
+
+/**
+ * @returns JSON object with totals of all phases since the last perf_reset(), for example
+ * {"render":{"threads":4,"time_ms":812.5,"cycles":2300000000,...,"branch_misses":null}}.
+ * Events that could not be counted by some of the threads are reported as null.
+ */
+std::string perf_report();
+
+/**
+ * Clears the totals of all phases.
+ */
+void perf_reset();
+
+}}
+
+#endif
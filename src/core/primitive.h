@@ -22,22 +22,49 @@ public:
             std::shared_ptr<Transform> ltow, std::shared_ptr<Transform> wtol);
     BBox local_bounds() const;
     BBox bounds() const;
+
+    /**
+     * Intersects the primitive's geometry with a ray transformed into the local coordinate system.
+     * The local ray direction is not renormalized, so 't' is shared between world and local space.
+     * @param ray Ray defined in world coordinate system.
+     * @param t Parametric distance along the ray to the closest intersection.
+     * @param isec Hit record to be updated.
+     * @returns True if an intersection was found closer than the current 't'.
+     */
     bool intersect(const Ray &ray, float &t, Intersection *i) const;
+
+    /**
+     * Computes surface data in world space, including the material, for a hit found by Primitive::intersect.
+     * Only needs to be called for the final, closest hit.
+     * @param ray Ray defined in world coordinate system.
+     * @param t Parametric distance of the intersection along the ray.
+     * @param isec Hit record.
+     * @param si Surface data to be filled.
+     */
+    void compute_surface_interaction(const Ray &ray, float t, const Intersection &isec, SurfaceInteraction &si) const;
     int num_faces() const { return _geom->num_faces(); }
+    std::shared_ptr<Geometry> geometry() const { return _geom; }
+    void set_geometry(std::shared_ptr<Geometry> geom) { _geom = geom; }
+    std::shared_ptr<Material> material() const { return _material; }
+    MaterialId material_id() const { return _material_id; }
+    void set_material_id(MaterialId id) { _material_id = id; }
+    const AffineTransform& local_to_world() const { return _ltow; }
+    const AffineTransform& world_to_local() const { return _wtol; }
     friend std::ostream& operator<<(std::ostream &out, const Primitive &primitive);
 
 protected:
+    AffineTransform _ltow; /// Transformation from local to world coordinate system
+    AffineTransform _wtol; /// Transformation from world to local coordinate system
     std::shared_ptr<Geometry> _geom;
     std::shared_ptr<Material> _material;
-    std::shared_ptr<Transform> _ltow; /// Transformation from local to world coordinate system
-    std::shared_ptr<Transform> _wtol; /// Transformation from world to local coordinate system
+    MaterialId _material_id = 0; /// Index of the material in the scene's material table
 };
 
 inline std::ostream& operator<<(std::ostream &out, const Primitive &primitive) {
     out << "{";
     out << "\"geometry\":" << primitive._geom << ",";
-    out << "\"local_to_world\":" << *(primitive._ltow) << ",";
-    out << "\"world_to_local\":" << *(primitive._wtol);
+    out << "\"local_to_world\":" << primitive._ltow << ",";
+    out << "\"world_to_local\":" << primitive._wtol;
     out << "}";
     return out;
 }
@@ -15,6 +15,14 @@ public:
     Renderer(std::shared_ptr<Camera> camera, std::shared_ptr<SurfaceIntegrator> surface_integrator)
         : _camera(camera), _surface_integrator(surface_integrator) {}
     virtual void render(const Scene *scene) const = 0;
+    std::shared_ptr<Camera> camera() const { return _camera; }
+
+    /**
+     * Adds memory held by the film and other rendering buffers to given usage.
+     */
+    virtual void memory_usage(MemoryUsage &usage) const {
+        _camera->_film->memory_usage(usage);
+    }
 
 protected:
     std::shared_ptr<Camera> _camera;
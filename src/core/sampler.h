@@ -63,8 +63,28 @@ public:
      */
     virtual Sampler * get_subsampler(int h_tiles, int v_tiles, int i, int j) = 0;
 
+    /**
+     * Provides the (average) number of samples the sampler generates per pixel of its window.
+     */
+    virtual int samples_per_pixel() const = 0;
+
+    /**
+     * Creates a sampler for one pass of a progressive render.
+     * @param spp Number of samples per pixel of the pass.
+     * @returns New sampler instance with the same window as this sampler.
+     */
+    virtual Sampler * get_pass_sampler(int spp) const = 0;
+
     virtual std::string to_string() const = 0;
 
+    /**
+     * Provides the image segment (in pixels, inclusive) the sampler generates samples for.
+     */
+    void get_window(int *x_min, int *x_max, int *y_min, int *y_max) const {
+        *x_min = _x_min; *x_max = _x_max;
+        *y_min = _y_min; *y_max = _y_max;
+    }
+
 protected:
     void compute_subwindow(int h_tiles, int v_tiles, int i, int j, int *x_min, int *x_max, int *y_min, int *y_max) const;
     int _x_min, _x_max, _y_min, _y_max;
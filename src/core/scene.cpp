@@ -1,8 +1,12 @@
 #include <ctime>
 #include <cmath>
 #include <thread>
+#include <set>
+#include <sstream>
 
 #include "core/scene.h"
+#include "core/perf.h"
+#include "core/stats.h"
 
 namespace gill { namespace core {
 
@@ -18,6 +22,10 @@ const int MaxDepth = 32;
 using namespace std;
 
 Scene::Scene(const std::vector<Primitive> &primitives) : _primitives(primitives) {
+    PerfScope scope("build");
+    for (auto &p : _primitives) {
+        p.set_material_id(_materials.add(p.material().get()));
+    }
     Primitive * prims = &_primitives[0];
     _accelerator.reset(new KdTree(_primitives.size(),
         IntersectionCost, TraversalCost, MaxGeoms, MaxDepth,
@@ -30,7 +38,51 @@ Scene::Scene(const std::vector<Primitive> &primitives) : _primitives(primitives)
 }
 
 bool Scene::intersect(const Ray &ray, float &t, Intersection *isec) const {
-    return _accelerator->intersect(ray, t, isec);
+    bool hit = _accelerator->intersect(ray, t, isec);
+    STAT(intersections += (isec != nullptr));
+    STAT(occlusions += (isec == nullptr));
+    STAT(hits += hit);
+    return hit;
+}
+
+void Scene::memory_usage(MemoryUsage &usage) const {
+    usage.primitives += _primitives.capacity() * sizeof(Primitive);
+    usage.materials += _materials.size() * sizeof(MaterialData);
+    _accelerator->memory_usage(usage);
+    set<const Geometry *> geometries;
+    for (auto &p : _primitives) {
+        if (geometries.insert(p.geometry().get()).second) {
+            p.geometry()->memory_usage(usage);
+        }
+    }
+}
+
+/** Seed of the random rays used for analyzing the accelerators. */
+const unsigned int AnalysisSeed = 7;
+
+string Scene::analyze_accelerators(int num_rays) const {
+    ostringstream out;
+    out << "{\"scene\":" << _accelerator->analyze(num_rays, AnalysisSeed) << ",\"geometries\":[";
+    set<const Geometry *> geometries;
+    for (auto &p : _primitives) {
+        KdTree *accelerator = p.geometry()->accelerator();
+        if (accelerator && geometries.insert(p.geometry().get()).second) {
+            out << (geometries.size() > 1 ? "," : "") << accelerator->analyze(num_rays, AnalysisSeed);
+        }
+    }
+    out << "]}";
+    return out.str();
+}
+
+void Scene::tune_accelerator(int num_rays) {
+    Primitive * prims = &_primitives[0];
+    _accelerator = KdTree::tune(_primitives.size(), { IntersectionCost, TraversalCost, MaxGeoms, MaxDepth }, num_rays,
+        [prims](uint32_t i) {
+            return prims[i].bounds();
+        },
+        [prims](uint32_t i, const Ray &ray, float &t, Intersection *isec) {
+            return prims[i].intersect(ray, t, isec);
+        });
 }
 
 }}
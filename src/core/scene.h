@@ -3,6 +3,7 @@
 
 #include "core/primitive.h"
 #include "core/kdtree.h"
+#include "core/material.h"
 #include "core/ray.h"
 #include "core/intersection.h"
 
@@ -16,12 +17,42 @@ public:
      * Find closest intersection of ray with any of the contained primitives.
      * @param ray Ray defined in world coordinate system.
      * @param t Parametric distance along the ray to the closest intersection.
-     * @param isec Additional intersection data.
+     * @param isec Hit record; see Scene::compute_surface_interaction for the full surface data.
      * @note The method will only modify 't' and 'isec' if an intersection closer than 't' was found.
      * @returns True if an intersection was found closer than the current 't'.
      */
     bool intersect(const Ray &ray, float &t, Intersection *isec) const;
 
+    /**
+     * Computes world-space surface data of the closest hit found by Scene::intersect.
+     */
+    void compute_surface_interaction(const Ray &ray, float t, const Intersection &isec, SurfaceInteraction &si) const {
+        isec.primitive->compute_surface_interaction(ray, t, isec, si);
+    }
+
+    const std::vector<Primitive>& primitives() const { return _primitives; }
+    const MaterialTable& materials() const { return _materials; }
+
+    /**
+     * Adds memory held by the primitives, their geometries (each counted once) and the accelerators to given usage.
+     */
+    void memory_usage(MemoryUsage &usage) const;
+
+    /**
+     * Analyzes quality of the scene accelerator and of the geometry accelerators (see gill::core::KdTree::analyze).
+     * @param num_rays Number of random rays traced through each accelerator.
+     * @returns JSON object with the metrics of the scene accelerator, and a list of metrics of the geometry accelerators.
+     */
+    std::string analyze_accelerators(int num_rays) const;
+
+    /**
+     * Rebuilds the scene accelerator with build parameters tuned for this scene (see gill::core::KdTree::tune).
+     * @param num_rays Number of rays used for measuring the candidate accelerators.
+     */
+    void tune_accelerator(int num_rays);
+
+    KdTree* accelerator() const { return _accelerator.get(); }
+
     int total_faces() const {
         int total = 0;
         for (auto &p : _primitives) {
@@ -32,6 +63,7 @@ public:
 
 protected:
     std::vector<Primitive> _primitives;
+    MaterialTable _materials;
     std::unique_ptr<KdTree> _accelerator;
 };
 
@@ -0,0 +1,128 @@
+/**
+ * @file
+ * Fixed-width packs of floats, mapped to SSE (4 lanes) and AVX (8 lanes) registers when the target supports them,
+ * with a scalar fallback otherwise (see gill::core::CoefficientSpectrum).
+ *
+ * Loads and stores are unaligned, since C++11 heap allocations are not guaranteed to honor alignas beyond
+ * the alignment of std::max_align_t; on current CPUs they are as fast as aligned accesses on aligned data.
+ */
+
+#ifndef GILL_CORE_SIMD_H_
+#define GILL_CORE_SIMD_H_
+
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__SSE__) && !defined(GILL_NO_SIMD)
+#include <immintrin.h>
+#define GILL_SSE
+#if defined(__AVX__)
+#define GILL_AVX
+#endif
+#endif
+
+namespace gill { namespace core {
+
+#ifdef GILL_SSE
+
+/**
+ * Pack of 4 floats in an SSE register.
+ */
+struct Float4 {
+    static const int Lanes = 4;
+    __m128 v;
+
+    Float4(__m128 _v) : v(_v) {}
+    explicit Float4(float f) : v(_mm_set1_ps(f)) {}
+
+    static inline Float4 load(const float *p) { return Float4(_mm_loadu_ps(p)); }
+    inline void store(float *p) const { _mm_storeu_ps(p, v); }
+
+    inline Float4 operator+(const Float4 &rhs) const { return Float4(_mm_add_ps(v, rhs.v)); }
+    inline Float4 operator-(const Float4 &rhs) const { return Float4(_mm_sub_ps(v, rhs.v)); }
+    inline Float4 operator*(const Float4 &rhs) const { return Float4(_mm_mul_ps(v, rhs.v)); }
+    inline Float4 operator/(const Float4 &rhs) const { return Float4(_mm_div_ps(v, rhs.v)); }
+
+    static inline Float4 min(const Float4 &a, const Float4 &b) { return Float4(_mm_min_ps(a.v, b.v)); }
+    static inline Float4 max(const Float4 &a, const Float4 &b) { return Float4(_mm_max_ps(a.v, b.v)); }
+    static inline Float4 sqrt(const Float4 &a) { return Float4(_mm_sqrt_ps(a.v)); }
+};
+
+#else
+
+/**
+ * Pack of 4 floats, processed lane by lane (targets without SSE, or GILL_NO_SIMD).
+ */
+struct Float4 {
+    static const int Lanes = 4;
+    float v[4];
+
+    Float4() {}
+    explicit Float4(float f) { for (int i = 0; i < Lanes; ++i) { v[i] = f; } }
+
+    static inline Float4 load(const float *p) { Float4 r; for (int i = 0; i < Lanes; ++i) { r.v[i] = p[i]; } return r; }
+    inline void store(float *p) const { for (int i = 0; i < Lanes; ++i) { p[i] = v[i]; } }
+
+    inline Float4 operator+(const Float4 &rhs) const { Float4 r; for (int i = 0; i < Lanes; ++i) { r.v[i] = v[i] + rhs.v[i]; } return r; }
+    inline Float4 operator-(const Float4 &rhs) const { Float4 r; for (int i = 0; i < Lanes; ++i) { r.v[i] = v[i] - rhs.v[i]; } return r; }
+    inline Float4 operator*(const Float4 &rhs) const { Float4 r; for (int i = 0; i < Lanes; ++i) { r.v[i] = v[i] * rhs.v[i]; } return r; }
+    inline Float4 operator/(const Float4 &rhs) const { Float4 r; for (int i = 0; i < Lanes; ++i) { r.v[i] = v[i] / rhs.v[i]; } return r; }
+
+    static inline Float4 min(const Float4 &a, const Float4 &b) { Float4 r; for (int i = 0; i < Lanes; ++i) { r.v[i] = std::min(a.v[i], b.v[i]); } return r; }
+    static inline Float4 max(const Float4 &a, const Float4 &b) { Float4 r; for (int i = 0; i < Lanes; ++i) { r.v[i] = std::max(a.v[i], b.v[i]); } return r; }
+    static inline Float4 sqrt(const Float4 &a) { Float4 r; for (int i = 0; i < Lanes; ++i) { r.v[i] = std::sqrt(a.v[i]); } return r; }
+};
+
+#endif
+
+#ifdef GILL_AVX
+
+/**
+ * Pack of 8 floats in an AVX register.
+ */
+struct Float8 {
+    static const int Lanes = 8;
+    __m256 v;
+
+    Float8(__m256 _v) : v(_v) {}
+    explicit Float8(float f) : v(_mm256_set1_ps(f)) {}
+
+    static inline Float8 load(const float *p) { return Float8(_mm256_loadu_ps(p)); }
+    inline void store(float *p) const { _mm256_storeu_ps(p, v); }
+
+    inline Float8 operator+(const Float8 &rhs) const { return Float8(_mm256_add_ps(v, rhs.v)); }
+    inline Float8 operator-(const Float8 &rhs) const { return Float8(_mm256_sub_ps(v, rhs.v)); }
+    inline Float8 operator*(const Float8 &rhs) const { return Float8(_mm256_mul_ps(v, rhs.v)); }
+    inline Float8 operator/(const Float8 &rhs) const { return Float8(_mm256_div_ps(v, rhs.v)); }
+
+    static inline Float8 min(const Float8 &a, const Float8 &b) { return Float8(_mm256_min_ps(a.v, b.v)); }
+    static inline Float8 max(const Float8 &a, const Float8 &b) { return Float8(_mm256_max_ps(a.v, b.v)); }
+    static inline Float8 sqrt(const Float8 &a) { return Float8(_mm256_sqrt_ps(a.v)); }
+};
+
+/** Widest pack supported by the target. */
+typedef Float8 FloatWide;
+
+#else
+
+typedef Float4 FloatWide;
+
+#endif
+
+/**
+ * Pack type used for arrays of n floats: a single 4-wide pack for up to 4 values (e.g., RGB),
+ * the widest supported pack otherwise.
+ */
+template <int n>
+struct FloatPack {
+    typedef typename std::conditional<n <= 4, Float4, FloatWide>::type type;
+    /** Number of floats, rounded up to a whole number of packs. */
+    static const int padded = (n + type::Lanes - 1) / type::Lanes * type::Lanes;
+    /** Alignment of the array: 16 bytes for a single 4-wide pack, 32 bytes otherwise. */
+    static const int alignment = n <= 4 ? 16 : 32;
+};
+
+}}
+
+#endif
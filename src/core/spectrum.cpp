@@ -16,4 +16,87 @@ SampledSpectrum SampledSpectrum::from_samples(const float *wavelengths, const fl
 // Precomputed RGB reflectance/illumination spectra
 #include "_rgb.h"
 
+#ifdef GILL_SPECTRAL
+
+/**
+ * Luminance of a spectrum given by the bins of the precomputed spectra, relative to the luminance
+ * of a constant spectrum of 1.
+ */
+float relative_luminance(const float *values) {
+    float y = 0.f, y_const = 0.f;
+    for (int i = 0; i < SpectrumSamples; ++i) {
+        y += values[i] * CIEY[i];
+        y_const += CIEY[i];
+    }
+    return y / y_const;
+}
+
+/** Scales of the upsampled spectra, mapping white RGB colors to spectra with a luminance of 1. */
+const float ReflectanceScale = 1.f / relative_luminance(ReflWhite);
+const float IlluminantScale = 1.f / relative_luminance(IllumWhite);
+
+/**
+ * Index of the bin of the precomputed spectra containing given wavelength.
+ */
+inline int spectrum_bin(float lambda) {
+    int bin = (int)((lambda - SpectrumMin) / (SpectrumMax - SpectrumMin) * SpectrumSamples);
+    return std::min(std::max(bin, 0), SpectrumSamples - 1);
+}
+
+Spectrum from_rgb(const RGB &rgb, const SampledWavelengths &wavelengths, ColorType type) {
+    bool refl = type == ColorType::Reflectance;
+    const float *white = refl ? ReflWhite : IllumWhite;
+    const float *cyan = refl ? ReflCyan : IllumCyan;
+    const float *magenta = refl ? ReflMagenta : IllumMagenta;
+    const float *yellow = refl ? ReflYellow : IllumYellow;
+    const float *red = refl ? ReflRed : IllumRed;
+    const float *green = refl ? ReflGreen : IllumGreen;
+    const float *blue = refl ? ReflBlue : IllumBlue;
+    float r = rgb[0], g = rgb[1], b = rgb[2];
+
+    Spectrum result;
+    for (int i = 0; i < HeroWavelengths; ++i) {
+        int bin = spectrum_bin(wavelengths.lambda[i]);
+        float value;
+        // Smits' method: white for the smallest component, then the secondary and primary colors
+        if (r <= g && r <= b) {
+            value = r * white[bin];
+            value += g <= b ? (g - r) * cyan[bin] + (b - g) * blue[bin] : (b - r) * cyan[bin] + (g - b) * green[bin];
+        } else if (g <= r && g <= b) {
+            value = g * white[bin];
+            value += r <= b ? (r - g) * magenta[bin] + (b - r) * blue[bin] : (b - g) * magenta[bin] + (r - b) * red[bin];
+        } else {
+            value = b * white[bin];
+            value += r <= g ? (r - b) * yellow[bin] + (g - r) * green[bin] : (g - b) * yellow[bin] + (r - g) * red[bin];
+        }
+        result[i] = std::max(0.f, value * (refl ? ReflectanceScale : IlluminantScale));
+    }
+    return result;
+}
+
+RGB to_rgb(const Spectrum &spectrum, const SampledWavelengths &wavelengths) {
+    // Monte Carlo estimate of the XYZ integrals, with uniform density of the wavelengths
+    float xyz[3] = { 0.f, 0.f, 0.f };
+    for (int i = 0; i < HeroWavelengths; ++i) {
+        int bin = spectrum_bin(wavelengths.lambda[i]);
+        xyz[0] += spectrum[i] * CIEX[bin];
+        xyz[1] += spectrum[i] * CIEY[bin];
+        xyz[2] += spectrum[i] * CIEZ[bin];
+    }
+    // Normalized by the CIE Y integral over the sampled range, so that a constant spectrum of 1 has a luminance of 1
+    float y_integral = 0.f;
+    for (int i = 0; i < SpectrumSamples; ++i) {
+        y_integral += CIEY[i];
+    }
+    float scale = SpectrumSamples / (HeroWavelengths * y_integral);
+    for (int i = 0; i < 3; ++i) {
+        xyz[i] *= scale;
+    }
+    float rgb[3];
+    xyz_to_rgb(xyz, rgb);
+    return RGB(rgb[0], rgb[1], rgb[2]);
+}
+
+#endif
+
 }}
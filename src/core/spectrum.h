@@ -7,18 +7,32 @@
 #include <vector>
 #include <algorithm>
 
+#include "core/random.h"
+#include "core/simd.h"
+
 namespace gill { namespace core {
 
 /**
  * Generic definition of a wavelength spectrum distribution with predefined number of discrete coefficients.
+ *
+ * The coefficients are padded to a whole number of SIMD packs (see gill::core::FloatPack), and the arithmetic
+ * operators process a full pack at a time. The padding lanes are zero-initialized and never observable
+ * (comparisons, indexing and is_black only look at the first num_coefs values).
  */
 template <int num_coefs>
-class CoefficientSpectrum {
+class alignas(FloatPack<num_coefs>::alignment) CoefficientSpectrum {
+protected:
+    typedef typename FloatPack<num_coefs>::type Pack;
+    static const int Padded = FloatPack<num_coefs>::padded;
+
 public:
     CoefficientSpectrum(float v = 0.0) {
         for (int i = 0; i < num_coefs; ++i) {
             c[i] = v;
         }
+        for (int i = num_coefs; i < Padded; ++i) {
+            c[i] = 0.0;
+        }
     }
 
     inline bool operator==(const CoefficientSpectrum &rhs) const {
@@ -35,7 +49,7 @@ public:
     }
 
     inline CoefficientSpectrum &operator+=(const CoefficientSpectrum &rhs) {
-        for (int i = 0; i < num_coefs; ++i) { c[i] += rhs.c[i]; }
+        for (int i = 0; i < Padded; i += Pack::Lanes) { (Pack::load(c + i) + Pack::load(rhs.c + i)).store(c + i); }
         return *this;
     }
 
@@ -45,7 +59,7 @@ public:
     }
 
     inline CoefficientSpectrum &operator-=(const CoefficientSpectrum &rhs) {
-        for (int i = 0; i < num_coefs; ++i) { c[i] -= rhs.c[i]; }
+        for (int i = 0; i < Padded; i += Pack::Lanes) { (Pack::load(c + i) - Pack::load(rhs.c + i)).store(c + i); }
         return *this;
     }
 
@@ -55,7 +69,8 @@ public:
     }
 
     inline CoefficientSpectrum &operator*=(float rhs) {
-        for (int i = 0; i < num_coefs; ++i) { c[i] *= rhs; }
+        Pack factor(rhs);
+        for (int i = 0; i < Padded; i += Pack::Lanes) { (Pack::load(c + i) * factor).store(c + i); }
         return *this;
     }
 
@@ -65,7 +80,8 @@ public:
     }
 
     inline CoefficientSpectrum &operator/=(float rhs) {
-        for (int i = 0; i < num_coefs; ++i) { c[i] /= rhs; }
+        Pack divisor(rhs);
+        for (int i = 0; i < Padded; i += Pack::Lanes) { (Pack::load(c + i) / divisor).store(c + i); }
         return *this;
     }
 
@@ -75,7 +91,7 @@ public:
     }
 
     inline CoefficientSpectrum &operator*=(const CoefficientSpectrum &rhs) {
-        for (int i = 0; i < num_coefs; ++i) { c[i] *= rhs.c[i]; }
+        for (int i = 0; i < Padded; i += Pack::Lanes) { (Pack::load(c + i) * Pack::load(rhs.c + i)).store(c + i); }
         return *this;
     }
 
@@ -85,6 +101,7 @@ public:
     }
 
     inline CoefficientSpectrum &operator/=(const CoefficientSpectrum &rhs) {
+        // Scalar, so that the zero padding lanes do not turn into NaNs (0/0)
         for (int i = 0; i < num_coefs; ++i) { c[i] /= rhs.c[i]; }
         return *this;
     }
@@ -115,16 +132,17 @@ public:
 
     friend CoefficientSpectrum clamp(const CoefficientSpectrum &spectrum, float min, float max) {
         CoefficientSpectrum result;
-        for (int i = 0; i < num_coefs; ++i) {
-            result.c[i] = std::min(std::max(spectrum.c[i], min), max);
+        Pack lo(min), hi(max);
+        for (int i = 0; i < Padded; i += Pack::Lanes) {
+            Pack::min(Pack::max(Pack::load(spectrum.c + i), lo), hi).store(result.c + i);
         }
         return result;
     }
 
     friend CoefficientSpectrum sqrt(const CoefficientSpectrum &spectrum) {
         CoefficientSpectrum result;
-        for (int i = 0; i < num_coefs; ++i) {
-            result.c[i] = std::sqrt(spectrum.c[i]);
+        for (int i = 0; i < Padded; i += Pack::Lanes) {
+            Pack::sqrt(Pack::load(spectrum.c + i)).store(result.c + i);
         }
         return result;
     }
@@ -138,7 +156,7 @@ public:
     }
 
 protected:
-    float c[num_coefs];
+    float c[Padded];
 };
 
 const float SpectrumMin = SPECTRUM_MIN;
@@ -150,6 +168,9 @@ const int SpectrumSamples = SPECTRUM_RES;
  */
 class SampledSpectrum : public CoefficientSpectrum<SpectrumSamples> {
 public:
+    SampledSpectrum(float v = 0.0) : CoefficientSpectrum<SpectrumSamples>(v) {}
+    SampledSpectrum(const CoefficientSpectrum<SpectrumSamples> &s) : CoefficientSpectrum<SpectrumSamples>(s) {}
+
     static SampledSpectrum from_samples(const float *w, const float *v, int n);
 };
 
@@ -167,7 +188,11 @@ inline void rgb_to_xyz(const float rgb[3], float xyz[3]) {
 
 class RGB : public CoefficientSpectrum<3> {
 public:
-    RGB(float r = 0.0, float g = 0.0, float b = 0.0) {
+    RGB(float v = 0.0) {
+        c[0] = v; c[1] = v; c[2] = v;
+    }
+
+    RGB(float r, float g, float b) {
         c[0] = r; c[1] = g; c[2] = b;
     }
 
@@ -177,11 +202,99 @@ public:
 };
 
 
+/**
+ * @returns Relative luminance (the Y coordinate) of a linear RGB color.
+ */
+inline float luminance(const RGB &rgb) {
+    return 0.212671f * rgb[0] + 0.715160f * rgb[1] + 0.072169f * rgb[2];
+}
+
 class XYZ : public CoefficientSpectrum<3> {
 };
 
+
+/** Number of wavelengths carried by each path in spectral mode. */
+const int HeroWavelengths = 4;
+
+/**
+ * Radiance or reflectance at the wavelengths carried by a path (see gill::core::SampledWavelengths).
+ * @note The coefficients fill a single 4-wide SIMD register.
+ */
+class HeroSpectrum : public CoefficientSpectrum<HeroWavelengths> {
+public:
+    HeroSpectrum(float v = 0.0) : CoefficientSpectrum<HeroWavelengths>(v) {}
+    HeroSpectrum(const CoefficientSpectrum<HeroWavelengths> &s) : CoefficientSpectrum<HeroWavelengths>(s) {}
+};
+
+/** Kinds of RGB colors, which are converted into spectra differently. */
+enum class ColorType {
+    Reflectance,
+    Illuminant
+};
+
+#ifdef GILL_SPECTRAL
+
+/**
+ * Wavelengths (in nm) carried by a path: a uniformly sampled hero wavelength, and HeroWavelengths - 1
+ * wavelengths at equal offsets from it, wrapped around the [SpectrumMin, SpectrumMax] range.
+ * All wavelengths thus have the same (uniform) probability density.
+ */
+struct SampledWavelengths {
+    float lambda[HeroWavelengths];
+    /** Whether the path carries only the hero wavelength any more (after dispersion). */
+    bool secondary_terminated;
+
+    static SampledWavelengths sample(RNG &rng) {
+        SampledWavelengths wavelengths;
+        float range = SpectrumMax - SpectrumMin;
+        float hero = random_float(rng, 0.f, range);
+        for (int i = 0; i < HeroWavelengths; ++i) {
+            wavelengths.lambda[i] = SpectrumMin + std::fmod(hero + i * range / HeroWavelengths, range);
+        }
+        wavelengths.secondary_terminated = false;
+        return wavelengths;
+    }
+
+    /**
+     * Stops carrying the secondary wavelengths, at wavelength-dependent scattering.
+     * @returns Whether they were still carried, i.e. whether the hero wavelength has to take over their contribution.
+     */
+    bool terminate_secondary() {
+        bool carried = !secondary_terminated;
+        secondary_terminated = true;
+        return carried;
+    }
+};
+
+typedef HeroSpectrum Spectrum;
+
+/**
+ * Upsamples an RGB color into a spectrum (using Smits' method and the precomputed RGB spectra),
+ * evaluated at given wavelengths.
+ */
+Spectrum from_rgb(const RGB &rgb, const SampledWavelengths &wavelengths, ColorType type);
+
+/**
+ * Converts radiance at given wavelengths into a (single-sample) estimate of its RGB color.
+ */
+RGB to_rgb(const Spectrum &spectrum, const SampledWavelengths &wavelengths);
+
+#else
+
+/**
+ * Wavelengths carried by a path; empty in RGB mode.
+ */
+struct SampledWavelengths {
+    static SampledWavelengths sample(RNG &rng) { return SampledWavelengths(); }
+};
+
 typedef RGB Spectrum;
 
+inline Spectrum from_rgb(const RGB &rgb, const SampledWavelengths &wavelengths, ColorType type) { return rgb; }
+inline RGB to_rgb(const Spectrum &spectrum, const SampledWavelengths &wavelengths) { return spectrum; }
+
+#endif
+
 }}
 
 #endif
@@ -0,0 +1,71 @@
+#include <mutex>
+#include <sstream>
+
+#include "core/stats.h"
+
+namespace gill { namespace core {
+
+using namespace std;
+
+const char *RayTypeNames[NumRayTypes] = { "camera", "reflection", "transmission", "diffuse" };
+
+static mutex stats_mutex;
+static RayStats merged_stats;
+
+void RayStats::merge(const RayStats &stats) {
+    for (int i = 0; i < NumRayTypes; ++i) {
+        rays[i] += stats.rays[i];
+    }
+    intersections += stats.intersections;
+    occlusions += stats.occlusions;
+    hits += stats.hits;
+    kdtree_traversals += stats.kdtree_traversals;
+    kdtree_nodes += stats.kdtree_nodes;
+    kdtree_leaves += stats.kdtree_leaves;
+    primitive_tests += stats.primitive_tests;
+    triangle_tests += stats.triangle_tests;
+    for (int i = 0; i < PathLengthBins; ++i) {
+        path_lengths[i] += stats.path_lengths[i];
+    }
+}
+
+string RayStats::to_json() const {
+    uint64_t queries = intersections + occlusions;
+    ostringstream out;
+    out << "{\"rays\":{";
+    for (int i = 0; i < NumRayTypes; ++i) {
+        out << (i > 0 ? "," : "") << "\"" << RayTypeNames[i] << "\":" << rays[i];
+    }
+    out << "},\"intersections\":" << intersections << ",\"occlusions\":" << occlusions << ",\"hits\":" << hits;
+    out << ",\"kdtree\":{\"traversals\":" << kdtree_traversals << ",\"nodes\":" << kdtree_nodes
+        << ",\"leaves\":" << kdtree_leaves << "}";
+    out << ",\"primitive_tests\":" << primitive_tests << ",\"triangle_tests\":" << triangle_tests;
+    if (queries > 0) {
+        out << ",\"per_query\":{\"nodes\":" << (double)kdtree_nodes / queries
+            << ",\"leaves\":" << (double)kdtree_leaves / queries
+            << ",\"primitive_tests\":" << (double)primitive_tests / queries
+            << ",\"triangle_tests\":" << (double)triangle_tests / queries << "}";
+    }
+    out << ",\"path_lengths\":[";
+    for (int i = 0; i < PathLengthBins; ++i) {
+        out << (i > 0 ? "," : "") << path_lengths[i];
+    }
+    out << "]}";
+    return out.str();
+}
+
+void merge_thread_stats() {
+    RayStats &stats = thread_stats();
+    lock_guard<mutex> lock(stats_mutex);
+    merged_stats.merge(stats);
+    stats.reset();
+}
+
+RayStats take_merged_stats() {
+    lock_guard<mutex> lock(stats_mutex);
+    RayStats stats = merged_stats;
+    merged_stats.reset();
+    return stats;
+}
+
+}}
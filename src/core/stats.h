@@ -0,0 +1,86 @@
+#ifndef GILL_CORE_STATS_H_
+#define GILL_CORE_STATS_H_
+
+#include <cstdint>
+#include <string>
+
+namespace gill { namespace core {
+
+/**
+ * Types of rays traced by the integrators.
+ */
+enum RayType {
+    CameraRay,
+    ReflectionRay,
+    TransmissionRay,
+    DiffuseRay,
+    NumRayTypes
+};
+
+/** Number of bins of the path length histogram (the last bin collects all longer paths). */
+const int PathLengthBins = 16;
+
+/**
+ * Ray tracing statistics, collected separately by each thread (see gill::core::thread_stats)
+ * and merged when the thread finishes its work.
+ */
+struct RayStats {
+    uint64_t rays[NumRayTypes] = {};
+    uint64_t intersections = 0; /// Closest-hit queries of gill::core::Scene
+    uint64_t occlusions = 0; /// Any-hit queries (without intersection data) of gill::core::Scene
+    uint64_t hits = 0;
+    uint64_t kdtree_traversals = 0;
+    uint64_t kdtree_nodes = 0; /// Interior nodes visited during kD-tree traversals
+    uint64_t kdtree_leaves = 0; /// Leaf nodes visited during kD-tree traversals
+    uint64_t primitive_tests = 0;
+    uint64_t triangle_tests = 0;
+    uint64_t path_lengths[PathLengthBins] = {};
+    uint64_t path_segments = 0; /// Segments of the path currently being traced
+
+    void reset() { *this = RayStats(); }
+    void merge(const RayStats &stats);
+
+    /**
+     * Adds the current path to the path length histogram.
+     */
+    void end_path() {
+        path_lengths[path_segments < PathLengthBins ? path_segments : PathLengthBins - 1]++;
+        path_segments = 0;
+    }
+
+    std::string to_json() const;
+};
+
+/**
+ * @returns Statistics of the calling thread.
+ * Inline, and constant-initialized (without a guard on first use), since STAT calls it on every counted event.
+ */
+inline RayStats& thread_stats() {
+    static thread_local RayStats stats;
+    return stats;
+}
+
+/**
+ * Adds statistics of the calling thread to the process-wide totals, and resets them.
+ */
+void merge_thread_stats();
+
+/**
+ * @returns Process-wide totals merged since the last call, resetting them.
+ */
+RayStats take_merged_stats();
+
+}}
+
+/**
+ * Updates a field of the calling thread's gill::core::RayStats, e.g. STAT(hits++).
+ * Statistics are only collected when built with GILL_STATS defined (see the ENABLE_STATS CMake option),
+ * otherwise the macro expands to nothing.
+ */
+#ifdef GILL_STATS
+#define STAT(expr) (gill::core::thread_stats().expr)
+#else
+#define STAT(expr) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,103 @@
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "core/trace.h"
+
+namespace gill { namespace core {
+
+using namespace std;
+using namespace std::chrono;
+
+/** Completed trace event. */
+struct TraceEvent {
+    const char *name, *category;
+    string args;
+    double ts, dur; /// Start and duration, in microseconds
+    int tid;
+};
+
+static bool trace_enabled = false;
+static mutex trace_mutex;
+static vector<TraceEvent> trace_events;
+static const steady_clock::time_point trace_epoch = steady_clock::now();
+static atomic<int> trace_threads(0);
+
+/**
+ * @returns Small sequential identifier of the calling thread, for readable timelines.
+ */
+static int trace_thread_id() {
+    thread_local int tid = ++trace_threads;
+    return tid;
+}
+
+static string escape(const string &value) {
+    string result;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+TraceScope::TraceScope(const char *name, const char *category)
+        : _name(name), _category(category), _enabled(trace_enabled) {
+    if (_enabled) {
+        _begin_time = steady_clock::now();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (!_enabled) {
+        return;
+    }
+    auto end_time = steady_clock::now();
+    TraceEvent event;
+    event.name = _name;
+    event.category = _category;
+    event.args = _args;
+    event.ts = duration<double, std::micro>(_begin_time - trace_epoch).count();
+    event.dur = duration<double, std::micro>(end_time - _begin_time).count();
+    event.tid = trace_thread_id();
+    lock_guard<mutex> lock(trace_mutex);
+    trace_events.push_back(event);
+}
+
+void TraceScope::arg(const char *key, const string &value) {
+    if (_enabled) {
+        _args += (_args.empty() ? "\"" : ",\"") + string(key) + "\":\"" + escape(value) + "\"";
+    }
+}
+
+void TraceScope::arg(const char *key, double value) {
+    if (_enabled) {
+        ostringstream out;
+        out << (_args.empty() ? "\"" : ",\"") << key << "\":" << value;
+        _args += out.str();
+    }
+}
+
+void TraceScope::set_enabled(bool enabled) {
+    trace_enabled = enabled;
+}
+
+bool TraceScope::enabled() {
+    return trace_enabled;
+}
+
+void write_trace(ostream &out) {
+    lock_guard<mutex> lock(trace_mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < trace_events.size(); ++i) {
+        const TraceEvent &event = trace_events[i];
+        out << (i > 0 ? ",\n" : "\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+            << "\",\"ph\":\"X\",\"ts\":" << fixed << event.ts << ",\"dur\":" << event.dur
+            << ",\"pid\":1,\"tid\":" << event.tid << ",\"args\":{" << event.args << "}}";
+    }
+    out << "\n]}" << endl;
+}
+
+}}
@@ -0,0 +1,54 @@
+#ifndef GILL_CORE_TRACE_H_
+#define GILL_CORE_TRACE_H_
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace gill { namespace core {
+
+/**
+ * Scoped timing instrumentation producing a timeline in the Chrome trace event format
+ * (viewable in chrome://tracing or Perfetto). Each scope becomes a single complete ("X") event
+ * on the timeline of the thread that entered it.
+ * @note When tracing is not enabled as the scope starts, the scope does nothing.
+ */
+class TraceScope {
+public:
+    /**
+     * Starts an event.
+     * @param name Name of the event, e.g. "load_mesh".
+     * @param category Category of the event, e.g. "parse".
+     */
+    TraceScope(const char *name, const char *category);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    /**
+     * Adds an argument, shown with the event in the trace viewer.
+     */
+    void arg(const char *key, const std::string &value);
+    void arg(const char *key, double value);
+
+    /**
+     * Enables or disables tracing (disabled by default).
+     */
+    static void set_enabled(bool enabled);
+    static bool enabled();
+
+protected:
+    const char *_name, *_category;
+    bool _enabled; /// Tracing was enabled when the scope started
+    std::string _args;
+    std::chrono::steady_clock::time_point _begin_time;
+};
+
+/**
+ * Writes all events recorded so far as a Chrome trace JSON object.
+ */
+void write_trace(std::ostream &out);
+
+}}
+
+#endif
@@ -17,6 +17,7 @@ namespace gill { namespace core {
  */
 class Transform {
     Matrix _m, _inv;
+    friend class AffineTransform;
 
 public:
     Transform() : _m(Identity), _inv(Identity) {}
@@ -144,6 +145,86 @@ inline std::ostream& operator<<(std::ostream &out, const Transform &transform) {
     return out;
 }
 
+/**
+ * Affine transformation stored inline as the upper 3x4 part of a gill::core::Transform matrix
+ * (the bottom row is implicitly [0,0,0,1]).
+ * Intended for per-instance data in intersection code where the projective divide
+ * and the indirection through a shared gill::core::Transform are not needed.
+ * @note Normals cannot be transformed without the inverse matrix. Use AffineTransform::transform_normal
+ * on the *inverse* transformation instead (it applies the transposed linear part).
+ */
+class AffineTransform {
+    float _m[3][4];
+
+public:
+    AffineTransform() : AffineTransform(Transform()) {}
+    AffineTransform(const Transform &t) {
+        const Matrix &m = t._m;
+        assert(m.m30 == 0.0 && m.m31 == 0.0 && m.m32 == 0.0 && m.m33 == 1.0);
+        _m[0][0] = m.m00; _m[0][1] = m.m01; _m[0][2] = m.m02; _m[0][3] = m.m03;
+        _m[1][0] = m.m10; _m[1][1] = m.m11; _m[1][2] = m.m12; _m[1][3] = m.m13;
+        _m[2][0] = m.m20; _m[2][1] = m.m21; _m[2][2] = m.m22; _m[2][3] = m.m23;
+    }
+
+    friend std::ostream& operator<<(std::ostream &out, const AffineTransform &transform);
+
+    inline Vector operator()(const Vector &v) const {
+        return Vector(
+            _m[0][0] * v.x + _m[0][1] * v.y + _m[0][2] * v.z,
+            _m[1][0] * v.x + _m[1][1] * v.y + _m[1][2] * v.z,
+            _m[2][0] * v.x + _m[2][1] * v.y + _m[2][2] * v.z
+        );
+    }
+
+    inline Point operator()(const Point &p) const {
+        return Point(
+            _m[0][0] * p.x + _m[0][1] * p.y + _m[0][2] * p.z + _m[0][3],
+            _m[1][0] * p.x + _m[1][1] * p.y + _m[1][2] * p.z + _m[1][3],
+            _m[2][0] * p.x + _m[2][1] * p.y + _m[2][2] * p.z + _m[2][3]
+        );
+    }
+
+    /**
+     * Transforms a normal using the transposed linear part of this transformation.
+     * Called on a world-to-local transformation, this maps local normals into world space.
+     */
+    inline Normal transform_normal(const Normal &n) const {
+        return Normal(
+            _m[0][0] * n.x + _m[1][0] * n.y + _m[2][0] * n.z,
+            _m[0][1] * n.x + _m[1][1] * n.y + _m[2][1] * n.z,
+            _m[0][2] * n.x + _m[1][2] * n.y + _m[2][2] * n.z
+        );
+    }
+
+    inline BBox operator()(const BBox &bbox) const {
+        const AffineTransform &xform = *this;
+        BBox result;
+        for (int i = 0; i < 8; ++i) {
+            result += xform(bbox[i]);
+        }
+        return result;
+    }
+
+    /**
+     * Transforms a ray without renormalizing its direction,
+     * so that parametric distances along the ray are preserved.
+     */
+    inline Ray operator()(const Ray &ray) const {
+        return Ray((*this)(ray.o), (*this)(ray.d));
+    }
+};
+
+inline std::ostream& operator<<(std::ostream &out, const AffineTransform &transform) {
+    out << "[";
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            out << transform._m[i][j] << ",";
+        }
+    }
+    out << "0,0,0,1]";
+    return out;
+}
+
 }}
 
 #endif
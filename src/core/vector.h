@@ -15,6 +15,11 @@
  * of std::vector<...>::iterator operators.
  * Therefore, the inline functions here will be intentionally copied for every
  * structure for which they make sense.
+ *
+ * The coordinates are stored in an array, so that operator[] is a plain indexed load (rather than a chain
+ * of selects), e.g. for the per-axis loops of ray/box tests and kD-tree traversal. The named coordinates
+ * alias the array through an anonymous struct in a union, which GCC and Clang support as an extension
+ * (including reading one member of the union after writing the other).
  */
 
 #ifndef GILL_CORE_VECTOR_H_
@@ -36,16 +41,20 @@ struct Normal;
  * Vector in a three-dimensional Euclidian space.
  */
 struct Vector {
-    float x, y, z;
-    Vector(float value = 0.0) : x(value), y(value), z(value) {}
-    Vector(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
-    Vector(const float *f) : x(*(f)), y(*(f + 1)), z(*(f + 2)) {}
-    Vector(const Vector &v) : x(v.x), y(v.y), z(v.z) {}
+    union {
+        float c[3];
+        struct { float x, y, z; };
+    };
+    Vector(float value = 0.0) : c{value, value, value} {}
+    Vector(float _x, float _y, float _z) : c{_x, _y, _z} {}
+    Vector(const float *f) : c{f[0], f[1], f[2]} {}
+    Vector(const Vector &v) : c{v.c[0], v.c[1], v.c[2]} {}
+    Vector &operator=(const Vector &v) { c[0] = v.c[0]; c[1] = v.c[1]; c[2] = v.c[2]; return *this; }
     Vector(const Point &p);
     Vector(const Normal &n);
 
-    inline float& operator[](int i) { return i == 0 ? x : (i == 1 ? y : z); }
-    inline float operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+    inline float& operator[](int i) { return c[i]; }
+    inline float operator[](int i) const { return c[i]; }
     inline bool operator==(const Vector &v) const { return x == v.x && y == v.y && z == v.z; }
     inline bool operator!=(const Vector &v) const { return x != v.x || y != v.y || z != v.z; }
     inline Vector operator-() const { return Vector(-x, -y, -z); }
@@ -68,16 +77,20 @@ inline std::ostream& operator<<(std::ostream &out, const Vector &v) {
  * Point in a three-dimensional Euclidian space.
  */
 struct Point {
-    float x, y, z;
-    Point(float value = 0.0) : x(value), y(value), z(value) {}
-    Point(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
-    Point(const float *f) : x(*(f)), y(*(f + 1)), z(*(f + 2)) {}
-    Point(const Point &p) : x(p.x), y(p.y), z(p.z) {}
+    union {
+        float c[3];
+        struct { float x, y, z; };
+    };
+    Point(float value = 0.0) : c{value, value, value} {}
+    Point(float _x, float _y, float _z) : c{_x, _y, _z} {}
+    Point(const float *f) : c{f[0], f[1], f[2]} {}
+    Point(const Point &p) : c{p.c[0], p.c[1], p.c[2]} {}
+    Point &operator=(const Point &p) { c[0] = p.c[0]; c[1] = p.c[1]; c[2] = p.c[2]; return *this; }
     Point(const Vector &v);
     Point(const Normal &n);
 
-    inline float& operator[](int i) { return i == 0 ? x : (i == 1 ? y : z); }
-    inline float operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+    inline float& operator[](int i) { return c[i]; }
+    inline float operator[](int i) const { return c[i]; }
     inline bool operator==(const Point &p) const { return x == p.x && y == p.y && z == p.z; }
     inline bool operator!=(const Point &p) const { return x != p.x || y != p.y || z != p.z; }
     inline Point operator+(const Vector &v) const { return Point(x + v.x, y + v.y, z + v.z); }
@@ -100,16 +113,20 @@ inline std::ostream& operator<<(std::ostream &out, const Point &p) {
  * Normal in a three-dimensional Euclidian space.
  */
 struct Normal {
-    float x, y, z;
-    Normal(float value = 0.0) : x(value), y(value), z(value) {}
-    Normal(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
-    Normal(const float *f) : x(*(f)), y(*(f + 1)), z(*(f + 2)) {}
-    Normal(const Normal &n) : x(n.x), y(n.y), z(n.z) {}
+    union {
+        float c[3];
+        struct { float x, y, z; };
+    };
+    Normal(float value = 0.0) : c{value, value, value} {}
+    Normal(float _x, float _y, float _z) : c{_x, _y, _z} {}
+    Normal(const float *f) : c{f[0], f[1], f[2]} {}
+    Normal(const Normal &n) : c{n.c[0], n.c[1], n.c[2]} {}
+    Normal &operator=(const Normal &n) { c[0] = n.c[0]; c[1] = n.c[1]; c[2] = n.c[2]; return *this; }
     Normal(const Vector &v);
     Normal(const Point &p);
 
-    inline float& operator[](int i) { return i == 0 ? x : (i == 1 ? y : z); }
-    inline float operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+    inline float& operator[](int i) { return c[i]; }
+    inline float operator[](int i) const { return c[i]; }
     inline bool operator==(const Normal &n) const { return x == n.x && y == n.y && z == n.z; }
     inline bool operator!=(const Normal &n) const { return x != n.x || y != n.y || z != n.z; }
     inline Normal operator-() const { return Normal(-x, -y, -z); }
@@ -173,12 +190,16 @@ inline float distance(const Point &p1, const Point &p2) {
     return length(p2 - p1);
 }
 
-inline Vector::Vector(const Point &p) : x(p.x), y(p.y), z(p.z) {}
-inline Vector::Vector(const Normal &n) : x(n.x), y(n.y), z(n.z) {}
-inline Point::Point(const Vector &v) : x(v.x), y(v.y), z(v.z) {}
-inline Point::Point(const Normal &n) : x(n.x), y(n.y), z(n.z) {}
-inline Normal::Normal(const Vector &v) : x(v.x), y(v.y), z(v.z) {}
-inline Normal::Normal(const Point &p) : x(p.x), y(p.y), z(p.z) {}
+static_assert(sizeof(Vector) == 3 * sizeof(float) && std::is_standard_layout<Vector>::value, "Vector coordinates must be contiguous");
+static_assert(sizeof(Point) == 3 * sizeof(float) && std::is_standard_layout<Point>::value, "Point coordinates must be contiguous");
+static_assert(sizeof(Normal) == 3 * sizeof(float) && std::is_standard_layout<Normal>::value, "Normal coordinates must be contiguous");
+
+inline Vector::Vector(const Point &p) : c{p.x, p.y, p.z} {}
+inline Vector::Vector(const Normal &n) : c{n.x, n.y, n.z} {}
+inline Point::Point(const Vector &v) : c{v.x, v.y, v.z} {}
+inline Point::Point(const Normal &n) : c{n.x, n.y, n.z} {}
+inline Normal::Normal(const Vector &v) : c{v.x, v.y, v.z} {}
+inline Normal::Normal(const Point &p) : c{p.x, p.y, p.z} {}
 
 template <typename V>
 inline bool has_nans(const V &v) {
@@ -0,0 +1,171 @@
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#include "denoiser/atrous.h"
+#include "core/math.h"
+
+namespace gill { namespace denoiser {
+
+using namespace std;
+using namespace gill::core;
+
+/** B3-spline kernel weights by distance from the center tap. */
+const float Kernel[3] = { 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+/** 3x3 Gaussian weights by distance from the center, used to prefilter the variance. */
+const float VarianceKernel[2] = { 1.f / 2.f, 1.f / 4.f };
+/** Offset of the luminance scale, so that pixels without noise are still filtered among identical neighbors. */
+const float LuminanceEpsilon = 1e-4f;
+/** Offset of the depth scale relative to the depth, so that depths on planes facing the camera are compared. */
+const float DepthEpsilon = 1e-3f;
+
+AtrousDenoiser::AtrousDenoiser(int iterations, float sigma_luminance, float sigma_normal, float sigma_depth,
+        float sigma_albedo, int threads)
+    : _iterations(iterations), _sigma_luminance(sigma_luminance), _sigma_normal(sigma_normal),
+    _sigma_depth(sigma_depth), _sigma_albedo(sigma_albedo), _threads(threads) {}
+
+void AtrousDenoiser::parallel_rows(int height, const function<void(int, int)> &func) const {
+    int threads = _threads > 0 ? _threads : std::max(1, (int)thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, height));
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(thread(func, height * t / threads, height * (t + 1) / threads));
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void AtrousDenoiser::denoise(const DenoiserInput &input, vector<RGB> &output) const {
+    int width = input.width, height = input.height;
+    size_t count = (size_t)width * height;
+    auto surface = [&input](int i) { return input.coverage[i] > 0.f; };
+    vector<RGB> color(count), next_color(count);
+    vector<float> variance(input.variance), next_variance(count), gradient(count, 0.f);
+    for (size_t i = 0; i < count; ++i) {
+        color[i] = surface(i) ? demodulate(input.color[i], input.albedo[i]) : input.color[i];
+    }
+
+    parallel_rows(height, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            for (int x = 0; x < width; ++x) {
+                int i = y * width + x;
+                if (!surface(i)) {
+                    continue;
+                }
+                // Pixels with a single sample have no variance estimate; use that of the neighborhood
+                if (variance[i] < 0.f) {
+                    float sum = 0.f, sum_sq = 0.f;
+                    int n = 0;
+                    for (int qy = std::max(0, y - 1); qy <= std::min(height - 1, y + 1); ++qy) {
+                        for (int qx = std::max(0, x - 1); qx <= std::min(width - 1, x + 1); ++qx) {
+                            int q = qy * width + qx;
+                            if (surface(q)) {
+                                float l = luminance(color[q]);
+                                sum += l;
+                                sum_sq += l * l;
+                                n++;
+                            }
+                        }
+                    }
+                    variance[i] = std::max(0.f, sum_sq / n - (sum / n) * (sum / n));
+                }
+                // Depth gradient: smaller one-sided difference along each axis, so that it does not cross edges
+                float gradients[2] = { Infinity, Infinity };
+                int neighbors[4][3] = { {x - 1, y, 0}, {x + 1, y, 0}, {x, y - 1, 1}, {x, y + 1, 1} };
+                for (auto &neighbor : neighbors) {
+                    int qx = neighbor[0], qy = neighbor[1];
+                    if (qx >= 0 && qx < width && qy >= 0 && qy < height && surface(qy * width + qx)) {
+                        float diff = std::abs(input.depth[qy * width + qx] - input.depth[i]);
+                        gradients[neighbor[2]] = std::min(gradients[neighbor[2]], diff);
+                    }
+                }
+                for (float g : gradients) {
+                    if (std::isfinite(g)) {
+                        gradient[i] = std::max(gradient[i], g);
+                    }
+                }
+            }
+        }
+    });
+
+    for (int iteration = 0; iteration < _iterations; ++iteration) {
+        int step = 1 << iteration;
+        parallel_rows(height, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    int p = y * width + x;
+                    if (!surface(p)) {
+                        next_color[p] = color[p];
+                        next_variance[p] = variance[p];
+                        continue;
+                    }
+                    float prefiltered = 0.f, prefilter_weight = 0.f;
+                    for (int qy = std::max(0, y - 1); qy <= std::min(height - 1, y + 1); ++qy) {
+                        for (int qx = std::max(0, x - 1); qx <= std::min(width - 1, x + 1); ++qx) {
+                            int q = qy * width + qx;
+                            if (surface(q)) {
+                                float w = VarianceKernel[std::abs(qx - x)] * VarianceKernel[std::abs(qy - y)];
+                                prefiltered += w * variance[q];
+                                prefilter_weight += w;
+                            }
+                        }
+                    }
+                    float luminance_scale = _sigma_luminance * std::sqrt(prefiltered / prefilter_weight) + LuminanceEpsilon;
+                    float lp = luminance(color[p]);
+                    const Vector &np = input.normal[p];
+                    float zp = input.depth[p];
+                    const RGB &ap = input.albedo[p];
+
+                    RGB sum_color(0.f);
+                    float sum_variance = 0.f, sum_weight = 0.f;
+                    for (int dy = -2; dy <= 2; ++dy) {
+                        int qy = y + dy * step;
+                        if (qy < 0 || qy >= height) {
+                            continue;
+                        }
+                        for (int dx = -2; dx <= 2; ++dx) {
+                            int qx = x + dx * step;
+                            int q = qy * width + qx;
+                            if (qx < 0 || qx >= width || !surface(q)) {
+                                continue;
+                            }
+                            float w = Kernel[std::abs(dx)] * Kernel[std::abs(dy)];
+                            if (q != p) {
+                                float distance = step * std::sqrt((float)(dx * dx + dy * dy));
+                                float e = std::abs(lp - luminance(color[q])) / luminance_scale
+                                    + std::abs(zp - input.depth[q]) / (_sigma_depth * gradient[p] * distance + DepthEpsilon * zp);
+                                if (_sigma_albedo > 0.f) {
+                                    RGB da = ap - input.albedo[q];
+                                    e += (da[0] * da[0] + da[1] * da[1] + da[2] * da[2]) / (_sigma_albedo * _sigma_albedo);
+                                }
+                                w *= std::pow(std::max(0.f, dot(np, input.normal[q])), _sigma_normal) * std::exp(-e);
+                            }
+                            sum_color += color[q] * w;
+                            sum_variance += w * w * variance[q];
+                            sum_weight += w;
+                        }
+                    }
+                    next_color[p] = sum_color / sum_weight;
+                    next_variance[p] = sum_variance / (sum_weight * sum_weight);
+                }
+            }
+        });
+        swap(color, next_color);
+        swap(variance, next_variance);
+    }
+
+    output.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        output[i] = surface(i) ? modulate(color[i], input.albedo[i]) : color[i];
+    }
+}
+
+string AtrousDenoiser::to_string() const {
+    ostringstream desc(ostringstream::ate);
+    desc << "atrous (" << _iterations << " iterations)";
+    return desc.str();
+}
+
+}}
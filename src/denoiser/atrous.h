@@ -0,0 +1,49 @@
+#ifndef GILL_DENOISER_ATROUS_H_
+#define GILL_DENOISER_ATROUS_H_
+
+#include <functional>
+
+#include "core/denoiser.h"
+
+namespace gill { namespace denoiser {
+
+/**
+ * Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010), with the luminance edge-stopping function
+ * scaled by the estimated standard deviation of each pixel as in spatiotemporal variance-guided filtering
+ * (Schied et al. 2017).
+ *
+ * The radiance is demodulated by the albedo before filtering, so that only the (smoother) illumination is blurred.
+ * Each iteration applies a 5x5 B3-spline kernel whose taps are 2^i pixels apart, with weights reduced
+ * by differences in luminance, normals, depth and albedo; the variance is filtered alongside with squared weights,
+ * so that later iterations stop at smaller luminance differences. Rows are split among threads.
+ */
+class AtrousDenoiser : public gill::core::Denoiser {
+public:
+    /**
+     * @param iterations Number of filter iterations; the footprint spans 2^(iterations + 2) pixels.
+     * @param sigma_luminance Scale of luminance differences, in multiples of their estimated standard deviation.
+     * @param sigma_normal Exponent of the cosine between normals.
+     * @param sigma_depth Scale of depth differences, in multiples of the local depth gradient over the tap distance.
+     * @param sigma_albedo Scale of albedo differences (0 disables the albedo term).
+     * @param threads Number of threads (0 for one per hardware thread).
+     */
+    AtrousDenoiser(int iterations, float sigma_luminance, float sigma_normal, float sigma_depth, float sigma_albedo,
+            int threads = 0);
+
+    virtual void denoise(const gill::core::DenoiserInput &input, std::vector<gill::core::RGB> &output) const override;
+    virtual std::string to_string() const override;
+
+protected:
+    /**
+     * Calls a function for disjoint ranges of rows [begin, end) on separate threads, and waits for them.
+     */
+    void parallel_rows(int height, const std::function<void(int, int)> &func) const;
+
+    int _iterations;
+    float _sigma_luminance, _sigma_normal, _sigma_depth, _sigma_albedo;
+    int _threads;
+};
+
+}}
+
+#endif
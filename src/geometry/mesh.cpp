@@ -4,12 +4,18 @@
 #include <regex>
 #include <vector>
 #include <ctime>
+#include <cassert>
+#include <stdexcept>
 
 #include "geometry/mesh.h"
+#include "core/perf.h"
+#include "core/stats.h"
 
 namespace gill { namespace geometry {
 
 const int MeshFileMagicNum = 0xdeadbeef;
+/** Default kD-tree build parameters of meshes. */
+const KdTreeParams DefaultTreeParams = { 80.0, 10.0, 8, 32 };
 
 using namespace std;
 
@@ -21,6 +27,7 @@ BBox Mesh::Triangle::bounds(Mesh *mesh) const {
 }
 
 bool Mesh::Triangle::intersect(Mesh *mesh, const Ray &ray, float &t, Intersection *i) const {
+    STAT(triangle_tests++);
     Point p0 = mesh->_vertices[i1], p1 = mesh->_vertices[i2], p2 = mesh->_vertices[i3];
     Vector e1 = p1 - p0, e2 = p2 - p0;
     Vector P = cross(ray.d, e2);
@@ -43,13 +50,11 @@ bool Mesh::Triangle::intersect(Mesh *mesh, const Ray &ray, float &t, Intersectio
     }
 
     float _t = dot(e2, Q) * inv_det;
-    if (_t < t) {
+    if (_t > 0.0 && _t < t) {
         t = _t;
         if (i) {
-            i->p = ray(t);
-            i->n = normalize(cross(e1, e2));
-            i->dpdu = e1;
-            i->dpdv = e2;
+            i->u = u;
+            i->v = v;
         }
         return true;
     } else {
@@ -74,6 +79,84 @@ bool Mesh::intersect(const Ray &ray, float &t, Intersection *isec) const {
 #endif
 }
 
+bool Mesh::intersect_triangle(uint32_t index, const Ray &ray, float &t, Intersection *isec) {
+    if (_triangles[index].intersect(this, ray, t, isec)) {
+        if (isec) {
+            isec->face = index;
+        }
+        return true;
+    }
+    return false;
+}
+
+void Mesh::compute_surface_interaction(const Ray &ray, float t, const Intersection &isec,
+        SurfaceInteraction &si) const {
+    const Triangle &tri = _triangles[isec.face];
+    Point p0 = _vertices[tri.i1], p1 = _vertices[tri.i2], p2 = _vertices[tri.i3];
+    Vector e1 = p1 - p0, e2 = p2 - p0;
+    si.p = p0 + e1 * isec.u + e2 * isec.v;
+    si.n = normalize(cross(e1, e2));
+    si.dpdu = e1;
+    si.dpdv = e2;
+}
+
+void Mesh::memory_usage(MemoryUsage &usage) const {
+    usage.mesh_vertices += _vertices.capacity() * sizeof(Point) + _normals.capacity() * sizeof(Normal);
+    usage.mesh_triangles += _triangles.capacity() * sizeof(Triangle);
+    if (_accelerator) {
+        _accelerator->memory_usage(usage);
+    }
+}
+
+void Mesh::build_accelerator() {
+    build_accelerator(DefaultTreeParams);
+}
+
+void Mesh::build_accelerator(const KdTreeParams &params) {
+    PerfScope scope("build");
+    Mesh * mesh_ptr = this;
+    _accelerator.reset(new KdTree(_triangles.size(), params.isec_cost, params.trav_cost,
+        params.max_geoms, params.max_depth,
+        [mesh_ptr](uint32_t i) {
+            const Triangle &tri = mesh_ptr->_triangles[i];
+            return tri.bounds(mesh_ptr);
+        },
+        [mesh_ptr](uint32_t i, const Ray &ray, float &t, Intersection *isec) {
+            return mesh_ptr->intersect_triangle(i, ray, t, isec);
+        }));
+    _bounds = _accelerator->bounds();
+}
+
+shared_ptr<Mesh> Mesh::from_tuned(const Mesh &mesh, int num_rays) {
+    PerfScope scope("build");
+    auto result = make_shared<Mesh>();
+    result->_vertices = mesh._vertices;
+    result->_normals = mesh._normals;
+    result->_triangles = mesh._triangles;
+    Mesh * mesh_ptr = result.get();
+    result->_accelerator = KdTree::tune(mesh._triangles.size(),
+        mesh._accelerator ? mesh._accelerator->params() : DefaultTreeParams, num_rays,
+        [mesh_ptr](uint32_t i) {
+            const Triangle &tri = mesh_ptr->_triangles[i];
+            return tri.bounds(mesh_ptr);
+        },
+        [mesh_ptr](uint32_t i, const Ray &ray, float &t, Intersection *isec) {
+            return mesh_ptr->intersect_triangle(i, ray, t, isec);
+        });
+    result->_bounds = result->_accelerator->bounds();
+    return result;
+}
+
+void Mesh::save_cache(const char *filename) {
+    string mesh_file(filename);
+    mesh_file += ".mesh";
+    save(mesh_file.c_str());
+
+    string tree_file(filename);
+    tree_file += ".kdtree";
+    _accelerator->save(tree_file.c_str());
+}
+
 void Mesh::save(const char *filename) {
     auto f = fopen(filename, "wb");
     fwrite(&MeshFileMagicNum, sizeof(MeshFileMagicNum), 1, f);
@@ -138,6 +221,9 @@ void Mesh::load(const char *filename) {
 
 shared_ptr<Mesh> Mesh::from_obj_file(const char *filename) {
     ifstream input(filename);
+    if (!input) {
+        throw std::runtime_error("cannot open mesh file");
+    }
     regex vertex_re("v ([0-9.e-]+) ([0-9.e-]+) ([0-9.e-]+)");
     regex face_re("f ([0-9]*)(?:/[0-9]*)?(?:/[0-9]*)? ([0-9]*)(?:/[0-9]*)?(?:/[0-9]*)? ([0-9]*)(?:/[0-9]*)?(?:/[0-9]*)?");
     string line;
@@ -150,26 +236,40 @@ shared_ptr<Mesh> Mesh::from_obj_file(const char *filename) {
             mesh->_triangles.push_back({stoi(match[1]) - 1, stoi(match[2]) - 1, stoi(match[3]) - 1});
         }
     }
-    Mesh * mesh_ptr = mesh.get();
-    mesh->_accelerator.reset(new KdTree(mesh->_triangles.size(), 80.0, 10.0, 8, 32,
-        [mesh_ptr](uint32_t i) {
-            const Triangle &tri = mesh_ptr->_triangles[i];
-            return tri.bounds(mesh_ptr);
-        },
-        [mesh_ptr](uint32_t i, const Ray &ray, float &t, Intersection *isec) {
-            const Triangle &tri = mesh_ptr->_triangles[i];
-            return tri.intersect(mesh_ptr, ray, t, isec);
-        }));
-    mesh->_bounds = mesh->_accelerator->bounds();
-
-    string mesh_file(filename);
-    mesh_file += ".mesh";
-    mesh->save(mesh_file.c_str());
+    mesh->build_accelerator();
+    mesh->save_cache(filename);
+    return mesh;
+}
 
-    string tree_file(filename);
-    tree_file += ".kdtree";
-    mesh->_accelerator->save(tree_file.c_str());
+shared_ptr<Mesh> Mesh::from_instances(const Mesh &mesh,
+        const vector<AffineTransform> &ltows, const vector<AffineTransform> &wtols) {
+    assert(ltows.size() == wtols.size());
+    auto result = make_shared<Mesh>();
+    result->_vertices.reserve(ltows.size() * mesh._vertices.size());
+    result->_normals.reserve(ltows.size() * mesh._normals.size());
+    result->_triangles.reserve(ltows.size() * mesh._triangles.size());
+    for (size_t i = 0; i < ltows.size(); ++i) {
+        int offset = result->_vertices.size();
+        for (const Point &v : mesh._vertices) {
+            result->_vertices.push_back(ltows[i](v));
+        }
+        for (const Normal &n : mesh._normals) {
+            result->_normals.push_back(normalize(wtols[i].transform_normal(n)));
+        }
+        for (const Triangle &t : mesh._triangles) {
+            result->_triangles.push_back({t.i1 + offset, t.i2 + offset, t.i3 + offset});
+        }
+    }
+    // Baked instances share the source mesh's (possibly tuned) build parameters
+    result->build_accelerator(mesh._accelerator ? mesh._accelerator->params() : DefaultTreeParams);
+    return result;
+}
 
+shared_ptr<Mesh> Mesh::from_triangles(const vector<Point> &vertices, const vector<Triangle> &triangles) {
+    auto mesh = make_shared<Mesh>();
+    mesh->_vertices = vertices;
+    mesh->_triangles = triangles;
+    mesh->build_accelerator();
     return mesh;
 }
 
@@ -187,8 +287,7 @@ shared_ptr<Mesh> Mesh::from_cache_file(const char *filename) {
             return tri.bounds(mesh_ptr);
         },
         [mesh_ptr](uint32_t i, const Ray &ray, float &t, Intersection *isec) {
-            const Triangle &tri = mesh_ptr->_triangles[i];
-            return tri.intersect(mesh_ptr, ray, t, isec);
+            return mesh_ptr->intersect_triangle(i, ray, t, isec);
         }));
     return mesh;
 }
@@ -8,6 +8,7 @@
 #include "core/geometry.h"
 #include "core/kdtree.h"
 #include "core/ray.h"
+#include "core/transform.h"
 #include "core/vector.h"
 #include "core/intersection.h"
 
@@ -38,14 +39,64 @@ public:
 
     BBox bounds() const override;
     bool intersect(const Ray &ray, float &t, Intersection *i) const override;
+    void compute_surface_interaction(const Ray &ray, float t, const Intersection &isec,
+            SurfaceInteraction &si) const override;
     int num_faces() const { return _triangles.size(); }
+    void memory_usage(MemoryUsage &usage) const override;
+    KdTree* accelerator() const override { return _accelerator.get(); }
+    int num_vertices() const { return _vertices.size(); }
+    const std::vector<Triangle>& triangles() const { return _triangles; }
     void save(const char *filename);
     void load(const char *filename);
     static std::shared_ptr<Mesh> from_obj_file(const char *filename);
     static std::shared_ptr<Mesh> from_cache_file(const char *filename);
+
+    /**
+     * Creates a mesh from vertices and triangles given in memory (e.g., generated procedurally).
+     * @param vertices Mesh vertices.
+     * @param triangles Mesh triangles, indexing into the vertices.
+     * @returns New mesh with its own accelerator.
+     */
+    static std::shared_ptr<Mesh> from_triangles(const std::vector<Point> &vertices,
+        const std::vector<Triangle> &triangles);
+
+    /**
+     * Bakes multiple instances of a mesh into a single mesh with its own accelerator.
+     * @param mesh Source mesh.
+     * @param ltows Local-to-world transformations of the individual instances.
+     * @param wtols World-to-local transformations of the individual instances (used for normals).
+     * @returns New mesh containing all the instances in the world coordinate system.
+     */
+    static std::shared_ptr<Mesh> from_instances(const Mesh &mesh,
+        const std::vector<AffineTransform> &ltows, const std::vector<AffineTransform> &wtols);
+
+    /**
+     * Copies a mesh with a kD-tree accelerator built with parameters tuned for it (see gill::core::KdTree::tune).
+     * The source mesh is left untouched, since it may be in use by scenes being rendered.
+     * @param mesh Source mesh.
+     * @param num_rays Number of rays used for measuring the candidate accelerators.
+     * @returns New mesh with its own accelerator.
+     */
+    static std::shared_ptr<Mesh> from_tuned(const Mesh &mesh, int num_rays);
+
+    /**
+     * (Re)builds the kD-tree accelerator over the mesh triangles.
+     */
+    void build_accelerator();
+    void build_accelerator(const KdTreeParams &params);
+
+    /**
+     * Saves the mesh and its accelerator into cache files next to given (obj) file.
+     */
+    void save_cache(const char *filename);
     friend std::ostream& operator<<(std::ostream& out, const Mesh& mesh);
 
 protected:
+    /**
+     * Intersects a single triangle, recording its index in the hit record (used by the accelerator).
+     */
+    bool intersect_triangle(uint32_t index, const Ray &ray, float &t, Intersection *isec);
+
     std::vector<Triangle> _triangles;
     std::vector<Point> _vertices;
     std::vector<Normal> _normals;
@@ -26,10 +26,7 @@ bool Plane::intersect(const Ray &ray, float &t, Intersection *isec) const {
     if (_t >= 0.0 && _t < t && abs(_p.x) <= 0.5 && abs(_p.y) <= 0.5) {
         t = _t;
         if (isec) {
-            isec->p = _p;
-            isec->n = Normal(0.0, 0.0, oz > 0.0 ? 1.0 : -1.0);
-            isec->dpdu = Vector(1.0, 0.0, 0.0);
-            isec->dpdv = Vector(0.0, 1.0, 0.0);
+            isec->face = 0;
         }
         return true;
     } else {
@@ -37,4 +34,12 @@ bool Plane::intersect(const Ray &ray, float &t, Intersection *isec) const {
     }
 }
 
+void Plane::compute_surface_interaction(const Ray &ray, float t, const Intersection &isec,
+        SurfaceInteraction &si) const {
+    si.p = ray(t);
+    si.n = Normal(0.0, 0.0, ray.o.z > 0.0 ? 1.0 : -1.0);
+    si.dpdu = Vector(1.0, 0.0, 0.0);
+    si.dpdv = Vector(0.0, 1.0, 0.0);
+}
+
 }}
@@ -19,6 +19,8 @@ class Plane : public Geometry {
 public:
     BBox bounds() const override;
     bool intersect(const Ray &ray, float &t, Intersection *isec) const override;
+    void compute_surface_interaction(const Ray &ray, float t, const Intersection &isec,
+            SurfaceInteraction &si) const override;
     int num_faces() const { return 1; }
 };
 
@@ -27,7 +27,8 @@ bool Sphere::intersect(const Ray &ray, float &t, Intersection *isec) const {
         float d = sqrt(discriminant);
         float t1 = 0.5 * (-b + d) / a;
         float t2 = 0.5 * (-b - d) / a;
-        _t = std::min(t1, t2);
+        // Closest intersection in front of the ray origin, which may lie inside the sphere
+        _t = std::min(t1, t2) >= 0.0 ? std::min(t1, t2) : std::max(t1, t2);
     } else if (discriminant == 0.0) {
         _t = -0.5 * b / a;
     }
@@ -35,8 +36,7 @@ bool Sphere::intersect(const Ray &ray, float &t, Intersection *isec) const {
     if (_t >= 0.0 && _t < t) {
         t = _t;
         if (isec) {
-            isec->p = ray(t);
-            isec->n = Normal((isec->p - Point(0.0)) / _radius);
+            isec->face = 0;
         }
         return true;
     } else {
@@ -44,4 +44,12 @@ bool Sphere::intersect(const Ray &ray, float &t, Intersection *isec) const {
     }
 }
 
+void Sphere::compute_surface_interaction(const Ray &ray, float t, const Intersection &isec,
+        SurfaceInteraction &si) const {
+    si.p = ray(t);
+    si.n = Normal((si.p - Point(0.0)) / _radius);
+    si.dpdu = Vector(0.0);
+    si.dpdv = Vector(0.0);
+}
+
 }}
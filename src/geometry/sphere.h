@@ -21,6 +21,8 @@ public:
     Sphere(float radius) : _radius(radius) {}
     BBox bounds() const override;
     bool intersect(const Ray &ray, float &t, Intersection *i) const override;
+    void compute_surface_interaction(const Ray &ray, float t, const Intersection &isec,
+            SurfaceInteraction &si) const override;
     int num_faces() const { return 1; }
 
 protected:
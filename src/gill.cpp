@@ -1,19 +1,114 @@
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+
+#include "core/batch.h"
 #include "core/parser.h"
+#include "core/perf.h"
+#include "core/trace.h"
+#include "server/server.h"
 
 using namespace std;
 using namespace gill::core;
+using namespace gill::server;
+
+/** Default memory budget (in MB) for documents kept in memory by the pipelined batch mode. */
+const float DefaultPipelineBudget = 1024.0;
+
+/**
+ * Prints quality metrics of the accelerators of all documents to stderr, without rendering.
+ */
+void analyze(Parser &parser, int num_rays) {
+    while (auto doc = parser.next_document()) {
+        cerr << "accelerators:" << doc->scene->analyze_accelerators(num_rays) << endl;
+    }
+}
+
+/**
+ * Writes the image of a rendered document to stdout, and its heatmap (if any) to a file.
+ */
+DocumentWriter ppm_writer(ostream *heatmap) {
+    return [heatmap](const Parser::Document &doc) {
+        auto film = doc.renderer->camera()->_film;
+        film->print_ppm();
+        if (heatmap) {
+            film->print_heatmap_ppm(*heatmap);
+        }
+    };
+}
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        cout << "Usage: " << argv[0] << "<scene_yaml_file>" << endl;
+    bool pipeline = false, server = false;
+    int analyze_rays = 0;
+    float budget = DefaultPipelineBudget;
+    const char *filename = nullptr, *socket_path = nullptr, *heatmap_path = nullptr, *trace_path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--server") == 0) {
+            server = true;
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            server = true;
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+            heatmap_path = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+            TraceScope::set_enabled(true);
+        } else if (strcmp(argv[i], "--analyze") == 0 && i + 1 < argc) {
+            analyze_rays = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            PerfCounters::set_enabled(true);
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipeline = true;
+        } else if (strcmp(argv[i], "--pipeline-budget") == 0 && i + 1 < argc) {
+            pipeline = true;
+            budget = atof(argv[++i]);
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (server) {
+        RenderServer render_server;
+        if (socket_path) {
+            render_server.serve_socket(socket_path);
+        } else {
+            render_server.serve_stdin();
+        }
         return 0;
     }
 
-    Parser parser(argv[1]);
-    while (auto doc = parser.next_document()) {
-        auto scene = doc->scene;
-        auto renderer = doc->renderer;
-        renderer->render(scene.get());
+    if (!filename) {
+        cout << "Usage: " << argv[0] << " [--counters] [--trace <json_file>] [--heatmap <ppm_file>] [--pipeline] [--pipeline-budget <MB>] <scene_yaml_file>" << endl;
+        cout << "       " << argv[0] << " --analyze <num_rays> <scene_yaml_file>" << endl;
+        cout << "       " << argv[0] << " --server | --socket <path>" << endl;
+        return 0;
+    }
+
+    ofstream heatmap;
+    if (heatmap_path) {
+        heatmap.open(heatmap_path);
+        if (!heatmap) {
+            cerr << "cannot open heatmap file" << endl;
+            return 1;
+        }
+    }
+
+    Parser parser(filename);
+    if (analyze_rays > 0) {
+        analyze(parser, analyze_rays);
+    } else if (pipeline) {
+        render_pipelined(parser, budget, heatmap_path != nullptr, ppm_writer(heatmap_path ? &heatmap : nullptr));
+    } else {
+        render_sequential(parser, heatmap_path != nullptr, ppm_writer(heatmap_path ? &heatmap : nullptr));
+    }
+
+    if (trace_path) {
+        ofstream trace(trace_path);
+        if (!trace) {
+            cerr << "cannot open trace file" << endl;
+            return 1;
+        }
+        write_trace(trace);
     }
     return 0;
 }
@@ -1,46 +1,88 @@
 #include "integrator/path.h"
-#include "core/montecarlo.h"
+#include "core/bsdf.h"
+#include "core/material.h"
+#include "core/stats.h"
 
 namespace gill { namespace integrator {
 
-Spectrum trace(int level, const Ray &ray, const Scene *scene, const Sample &sample) {
+/** Offset of secondary ray origins along the surface normal, avoiding self-intersections. */
+const float RayEpsilon = 0.01f;
+
+/**
+ * Records the features of a hit, replacing those of previous (mirror) hits of the path;
+ * the depth accumulates the lengths of the path segments.
+ */
+void record_features(const Ray &ray, float t, const SurfaceInteraction &si, const MaterialTable &materials,
+        SurfaceFeatures *features) {
+    features->hit = true;
+    features->albedo = clamp(materials[si.material].color, 0.f, 1.f);
+    Vector n = normalize(Vector(si.n));
+    features->normal = dot(n, ray.d) > 0.f ? -n : n;
+    features->depth += t * length(ray.d);
+}
+
+/**
+ * @param features Receives the features of the hit, and is passed on to the next hit after a mirror reflection
+ * (but not after scattering by glass, whose random choice between reflection and refraction would make
+ * the features as noisy as the radiance).
+ */
+Spectrum trace(int level, const Ray &ray, const Scene *scene, SampledWavelengths &wavelengths,
+        RNG &rng, MemoryArena &arena, SurfaceFeatures *features) {
     if (level < 0) {
         return Spectrum(0.f);
     }
 
     Intersection isec;
     float t = Infinity;
-    if (scene->intersect(ray, t, &isec)) {
-        if (!is_black(isec.emit)) {
-            return isec.emit;
-        } else if (!is_black(isec.refl)) {
-            Ray next_ray(isec.p, reflect(ray.d, isec.n));
-            return isec.refl * trace(level - 1, next_ray, scene, sample);
-        } else if (!is_black(isec.trsm)) {
-            Ray next_ray(isec.p, normalize(ray.d + isec.n * 0.1));
-            return isec.trsm * trace(level - 1, next_ray, scene, sample);
-        } else if (!is_black(isec.diff)) {
-            Vector next_normal = uniform_hemisphere_sample(sample.lens_u, sample.lens_v);
-            next_normal = normalize(isec.n + next_normal);
-            /*
-            if (isec.dpdu.x != 0.f || isec.dpdu.y != 0.f || isec.dpdu.z != 0.f) {
-                isec.n = normalize(isec.n);
-                Vector tmp1 = normalize(isec.dpdu);
-                Vector tmp2 = normalize(cross(tmp1, isec.n));
-                auto xform = Transform::coord_sys(tmp1, tmp2, isec.n);
-                next_normal = normalize((*xform)(next_normal));
-            }
-            */
-            Ray next_ray(isec.p + next_normal * 0.01, next_normal);
-            return isec.diff * trace(level - 1, next_ray, scene, sample);
-        }
+    STAT(path_segments++);
+    if (!scene->intersect(ray, t, &isec)) {
+        return Spectrum(0.f);
+    }
+    SurfaceInteraction si;
+    scene->compute_surface_interaction(ray, t, isec, si);
+    const MaterialTable &materials = scene->materials();
+    if (features) {
+        record_features(ray, t, si, materials, features);
+    }
+    Spectrum emit = materials.emission(si.material, wavelengths);
+    if (!is_black(emit)) {
+        return emit;
+    }
+    BSDF *bsdf = materials.bsdf(si.material, si, wavelengths, arena);
+    if (!bsdf) {
+        return Spectrum(0.f);
+    }
+
+    // Sample the incident direction proportionally to the BSDF, in the shading coordinate system
+    ShadingFrame frame(si.n);
+    Vector wo = frame.to_local(normalize(-ray.d));
+    Vector wi;
+    float pdf;
+    BxDF::Type type;
+    float u1 = random_float(rng, 0.f, 1.f), u2 = random_float(rng, 0.f, 1.f), u3 = random_float(rng, 0.f, 1.f);
+    Spectrum f = bsdf->sample(wo, wi, u1, u2, u3, &pdf, &type);
+    if (pdf == 0.f || cos_theta(wi) == 0.f || is_black(f)) {
+        return Spectrum(0.f);
     }
 
-    return Spectrum(0.f);
+    Vector offset = frame.n * (cos_theta(wi) > 0.f ? RayEpsilon : -RayEpsilon);
+    Ray next_ray(si.p + offset, frame.to_world(wi));
+    if (!(static_cast<int>(type) & static_cast<int>(BxDF::Type::Specular))) {
+        STAT(rays[DiffuseRay]++);
+    } else if (static_cast<int>(type) & static_cast<int>(BxDF::Type::Transmission)) {
+        STAT(rays[TransmissionRay]++);
+    } else {
+        STAT(rays[ReflectionRay]++);
+    }
+    return f * (abs_cos_theta(wi) / pdf) * trace(level - 1, next_ray, scene, wavelengths, rng, arena,
+        materials[si.material].kind == MaterialKind::Mirror ? features : nullptr);
 }
 
-Spectrum PathIntegrator::Li(const Ray &ray, const Scene *scene, const Sample &sample) const {
-    return trace(_max_depth, ray, scene, sample);
+Spectrum PathIntegrator::Li(const Ray &ray, const Scene *scene, const Sample &sample,
+        SampledWavelengths &wavelengths, RNG &rng, MemoryArena &arena, SurfaceFeatures *features) const {
+    Spectrum L = trace(_max_depth, ray, scene, wavelengths, rng, arena, features);
+    STAT(end_path());
+    return L;
 }
 
 }}
@@ -13,7 +13,9 @@ public:
         _max_depth = max_depth;
     }
 
-    virtual Spectrum Li(const Ray &ray, const Scene *scene, const Sample &sample) const override;
+    virtual Spectrum Li(const Ray &ray, const Scene *scene, const Sample &sample,
+            SampledWavelengths &wavelengths, RNG &rng, MemoryArena &arena,
+            SurfaceFeatures *features = nullptr) const override;
 
 protected:
     int _max_depth;
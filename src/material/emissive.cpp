@@ -4,12 +4,12 @@ namespace gill { namespace material {
 
 using namespace gill::core;
 
-EmissiveMaterial::EmissiveMaterial(const Spectrum &emissive)
+EmissiveMaterial::EmissiveMaterial(const RGB &emissive)
     : _emissive(clamp(emissive, 0.f, 1.f)) {
 }
 
-BSDF * EmissiveMaterial::bsdf(const Intersection &isec) const {
-    return nullptr;
+MaterialData EmissiveMaterial::data() const {
+    return { MaterialKind::Emissive, 0.f, 0.f, _emissive };
 }
 
 }}
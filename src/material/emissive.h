@@ -3,7 +3,6 @@
 
 #include "core/material.h"
 #include "core/spectrum.h"
-#include "core/bsdf.h"
 
 namespace gill { namespace material {
 
@@ -11,14 +10,12 @@ using namespace gill::core;
 
 class EmissiveMaterial : public Material {
 public:
-    EmissiveMaterial(const Spectrum &emissive);
+    EmissiveMaterial(const RGB &emissive);
 
-    //TODO: what should a light return?
-    virtual BSDF * bsdf(const Intersection &isec) const override;
-    virtual Spectrum _emit() const override { return _emissive; }
+    virtual MaterialData data() const override;
 
 protected:
-    Spectrum _emissive;
+    RGB _emissive;
 };
 
 }}
@@ -4,17 +4,12 @@ namespace gill { namespace material {
 
 using namespace gill::core;
 
-GlassMaterial::GlassMaterial(const Spectrum &kd) : _kd(clamp(kd, 0.f, 1.f)) {
-    _bsdf = new BSDF();
-    _bsdf->add(new LambertianReflection(_kd));
+GlassMaterial::GlassMaterial(const RGB &kd, float eta, float dispersion)
+    : _kd(clamp(kd, 0.f, 1.f)), _eta(eta), _dispersion(dispersion) {
 }
 
-GlassMaterial::~GlassMaterial() {
-    delete _bsdf;
-}
-
-BSDF * GlassMaterial::bsdf(const Intersection &isec) const {
-    return _bsdf;
+MaterialData GlassMaterial::data() const {
+    return { MaterialKind::Glass, _eta, _dispersion, _kd };
 }
 
 }}
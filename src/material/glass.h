@@ -3,7 +3,6 @@
 
 #include "core/material.h"
 #include "core/spectrum.h"
-#include "core/bsdf.h"
 
 namespace gill { namespace material {
 
@@ -11,14 +10,18 @@ using namespace gill::core;
 
 class GlassMaterial : public Material {
 public:
-    GlassMaterial(const Spectrum &kd);
-    ~GlassMaterial();
-    virtual BSDF * bsdf(const Intersection &isec) const override;
-    virtual Spectrum _trsm() const override { return _kd; }
+    /**
+     * @param kd Transmittance.
+     * @param eta Index of refraction of the glass at 550nm (outside is assumed to be vacuum).
+     * @param dispersion Cauchy coefficient B (in squared micrometers) of the index of refraction; only used
+     * in spectral mode.
+     */
+    GlassMaterial(const RGB &kd, float eta = 1.5f, float dispersion = 0.f);
+    virtual MaterialData data() const override;
 
 protected:
-    Spectrum _kd;
-    BSDF * _bsdf;
+    RGB _kd;
+    float _eta, _dispersion;
 };
 
 }}
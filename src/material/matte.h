@@ -3,7 +3,6 @@
 
 #include "core/material.h"
 #include "core/spectrum.h"
-#include "core/bsdf.h"
 
 namespace gill { namespace material {
 
@@ -11,14 +10,11 @@ using namespace gill::core;
 
 class MatteMaterial : public Material {
 public:
-    MatteMaterial(const Spectrum &kd);
-    ~MatteMaterial();
-    virtual BSDF * bsdf(const Intersection &isec) const override;
-    virtual Spectrum _diff() const override { return _kd; }
+    MatteMaterial(const RGB &kd);
+    virtual MaterialData data() const override;
 
 protected:
-    Spectrum _kd;
-    BSDF * _bsdf;
+    RGB _kd;
 };
 
 }}
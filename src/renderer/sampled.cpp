@@ -1,50 +1,115 @@
 #include <ctime>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <memory>
 
 #include "renderer/sampled.h"
 #include "core/random.h"
 #include "core/montecarlo.h"
+#include "core/perf.h"
+#include "core/stats.h"
+#include "core/trace.h"
 
 namespace gill { namespace renderer {
 
 using namespace std;
 using namespace std::chrono;
 
-void render_tile(const SurfaceIntegrator *si, const Scene *scene, const Camera *camera, Sampler *sampler) {
+/** Identification of checkpoint files, followed by the format version. */
+const char CheckpointMagic[8] = { 'G', 'I', 'L', 'L', 'C', 'K', 'P', 'T' };
+const int32_t CheckpointVersion = 3;
+
+/**
+ * Header of a checkpoint file, followed by the raw film pixels (see gill::core::Film::write_pixels).
+ * A checkpoint is only resumed if all fields but 'completed' match the current render.
+ */
+struct CheckpointHeader {
+    uint64_t document_hash; /// See gill::renderer::ProgressiveOptions::document_hash
+    int32_t xres, yres;
+    int32_t spp, pass_spp, passes;
+    int32_t thread_tiles[2]; /// Passes seed the random numbers of each tile, so the tiling must match
+    int32_t filter_sampling;
+    int32_t noise_estimate;
+    int32_t features;
+    int32_t completed;
+};
+
+/**
+ * Renders the samples of a sampler into a thread-local film tile, merged into the film at the end.
+ * @param seed Seed of the random number generator, unique for each tile and pass.
+ * @param half True if the samples also go to the film's noise estimation buffer.
+ */
+void render_tile(const SurfaceIntegrator *si, const Scene *scene, const Camera *camera, Sampler *sampler, int tile,
+        unsigned int seed, bool half) {
+    PerfScope scope("render");
+    TraceScope trace("render_tile", "render");
+    trace.arg("tile", tile);
+    Film *film = camera->_film.get();
+    int x_min, x_max, y_min, y_max;
+    sampler->get_window(&x_min, &x_max, &y_min, &y_max);
+    FilmTile film_tile(film, x_min, x_max, y_min, y_max);
+    if (film_tile.empty()) {
+        // The sampler's window lies outside of the image
+        return;
+    }
     Sample *samples = new Sample[sampler->max_batch_size()];
-    RNG rng;
+    RNG rng(seed);
+    MemoryArena arena;
     int count;
+    TraversalCost cost = { 0, 0 };
+    TraversalCostScope cost_scope(film->has_heatmap() ? &cost : nullptr);
     while ((count = sampler->get_sample_batch(samples, rng)) > 0) {
         for (int i = 0; i < count; ++i) {
-            Ray ray = camera->generate_ray(samples[i]);
-            camera->_film->add_sample(samples[i], si->Li(ray, scene, samples[i]));
+            Sample shifted;
+            float filter_weight = film->sample_filter(samples[i], shifted);
+            Ray ray = camera->generate_ray(shifted);
+            STAT(rays[CameraRay]++);
+            uint64_t cost_before = cost.nodes + cost.tests;
+            SampledWavelengths wavelengths = SampledWavelengths::sample(rng);
+            SurfaceFeatures features;
+            RGB radiance = to_rgb(si->Li(ray, scene, shifted, wavelengths, rng, arena,
+                film_tile.has_features() ? &features : nullptr), wavelengths);
+            film_tile.add_sample(samples[i], radiance, filter_weight);
+            if (film_tile.has_features()) {
+                film_tile.add_features(samples[i], radiance * filter_weight, features);
+            }
+            arena.reset();
+            if (film->has_heatmap()) {
+                film->add_cost(samples[i], cost.nodes + cost.tests - cost_before);
+            }
         }
     }
     delete[] samples;
+    film->merge_tile(film_tile, half);
+#ifdef GILL_STATS
+    merge_thread_stats();
+#endif
 }
 
 SampledRenderer::SampledRenderer(shared_ptr<Camera> camera, shared_ptr<SurfaceIntegrator> surface_integrator,
-        shared_ptr<Sampler> sampler, int thread_tiles[2])
-    : Renderer(camera, surface_integrator), _sampler(sampler) {
+        shared_ptr<Sampler> sampler, int thread_tiles[2], const ProgressiveOptions &progressive)
+    : Renderer(camera, surface_integrator), _sampler(sampler), _progressive(progressive) {
     _thread_tiles[0] = thread_tiles[0];
     _thread_tiles[1] = thread_tiles[1];
 }
 
-void SampledRenderer::render(const Scene *scene) const {
-    int res_x = _camera->_film->_xres;
-    int res_y = _camera->_film->_yres;
-
-    auto begin_time = high_resolution_clock::now();
-    if (_thread_tiles[0] > 1 || _thread_tiles[1] > 1) {
+void SampledRenderer::render_pass(const Scene *scene, Sampler *sampler, int pass) const {
+    int tiles = _thread_tiles[0] * _thread_tiles[1];
+    bool half = pass % 2 == 0;
+    if (tiles > 1) {
         vector<Sampler *> subsamplers;
         vector<thread> threads;
         for (int j = 0; j < _thread_tiles[1]; ++j) {
             for (int i = 0; i < _thread_tiles[0]; ++i) {
-                Sampler * subsampler = _sampler->get_subsampler(_thread_tiles[0], _thread_tiles[1], i, j);
+                Sampler * subsampler = sampler->get_subsampler(_thread_tiles[0], _thread_tiles[1], i, j);
                 subsamplers.push_back(subsampler);
-                threads.push_back(thread(render_tile, _surface_integrator.get(), scene, _camera.get(), subsampler));
+                int tile = j * _thread_tiles[0] + i;
+                threads.push_back(thread(render_tile, _surface_integrator.get(), scene, _camera.get(), subsampler,
+                    tile, pass * tiles + tile, half));
             }
         }
         for (auto &t : threads) {
@@ -54,17 +119,188 @@ void SampledRenderer::render(const Scene *scene) const {
             delete s;
         }
     } else {
-        render_tile(_surface_integrator.get(), scene, _camera.get(), _sampler.get());
+        render_tile(_surface_integrator.get(), scene, _camera.get(), sampler, 0, pass, half);
+    }
+}
+
+int SampledRenderer::load_checkpoint(int passes) const {
+    ifstream in(_progressive.checkpoint, ios::binary);
+    if (!in) {
+        return 0;
+    }
+    Film *film = _camera->_film.get();
+    char magic[sizeof(CheckpointMagic)];
+    int32_t version;
+    CheckpointHeader header;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, CheckpointMagic, sizeof(magic)) != 0
+            || !in.read((char *)&version, sizeof(version)) || version != CheckpointVersion
+            || !in.read((char *)&header, sizeof(header))) {
+        cerr << "ignoring invalid checkpoint file " << _progressive.checkpoint << endl;
+        return 0;
+    }
+    if (header.document_hash != _progressive.document_hash
+            || header.xres != film->_xres || header.yres != film->_yres || header.spp != _sampler->samples_per_pixel()
+            || header.pass_spp != _progressive.pass_spp || header.passes != passes
+            || header.thread_tiles[0] != _thread_tiles[0] || header.thread_tiles[1] != _thread_tiles[1]
+            || header.filter_sampling != (int32_t)film->filter_sampling()
+            || header.noise_estimate != (int32_t)film->has_noise_estimate()
+            || header.features != (int32_t)film->has_features()
+            || header.completed < 0 || header.completed > passes) {
+        cerr << "ignoring checkpoint file " << _progressive.checkpoint << " of a different render" << endl;
+        return 0;
+    }
+    if (!film->read_pixels(in)) {
+        cerr << "ignoring truncated checkpoint file " << _progressive.checkpoint << endl;
+        film->clear();
+        return 0;
+    }
+    return header.completed;
+}
+
+void SampledRenderer::save_checkpoint(int passes, int completed) const {
+    TraceScope trace("checkpoint", "render");
+    const Film *film = _camera->_film.get();
+    CheckpointHeader header;
+    header.document_hash = _progressive.document_hash;
+    header.xres = film->_xres;
+    header.yres = film->_yres;
+    header.spp = _sampler->samples_per_pixel();
+    header.pass_spp = _progressive.pass_spp;
+    header.passes = passes;
+    header.thread_tiles[0] = _thread_tiles[0];
+    header.thread_tiles[1] = _thread_tiles[1];
+    header.filter_sampling = film->filter_sampling();
+    header.noise_estimate = film->has_noise_estimate();
+    header.features = film->has_features();
+    header.completed = completed;
+    // Written next to the checkpoint and renamed, so that a job killed while writing keeps the previous checkpoint
+    string temp = _progressive.checkpoint + ".tmp";
+    {
+        ofstream out(temp, ios::binary);
+        out.write(CheckpointMagic, sizeof(CheckpointMagic));
+        out.write((const char *)&CheckpointVersion, sizeof(CheckpointVersion));
+        out.write((const char *)&header, sizeof(header));
+        film->write_pixels(out);
+        if (!out) {
+            cerr << "cannot write checkpoint file " << temp << endl;
+            return;
+        }
+    }
+    if (rename(temp.c_str(), _progressive.checkpoint.c_str()) != 0) {
+        cerr << "cannot replace checkpoint file " << _progressive.checkpoint << endl;
+    }
+}
+
+void SampledRenderer::render_progressive(const Scene *scene) const {
+    Film *film = _camera->_film.get();
+    int spp = _sampler->samples_per_pixel();
+    int pass_spp = _progressive.pass_spp;
+    int passes = (spp + pass_spp - 1) / pass_spp;
+    if (_progressive.target_noise > 0.f) {
+        film->enable_noise_estimate();
+    }
+    bool checkpoints = !_progressive.checkpoint.empty();
+    int completed = checkpoints ? load_checkpoint(passes) : 0;
+    int resumed = completed;
+
+    auto begin_time = high_resolution_clock::now(), checkpoint_time = begin_time;
+    double pass_time = 0.0;
+    float noise = (film->has_noise_estimate() && completed > 0) ? film->estimate_noise() : Infinity;
+    string stop = "spp";
+    while (completed < passes) {
+        duration<double> elapsed = high_resolution_clock::now() - begin_time;
+        if (_progressive.time_budget > 0.0 && elapsed.count() + pass_time > _progressive.time_budget) {
+            stop = "time_budget";
+            break;
+        }
+        if (_progressive.target_noise > 0.f && noise <= _progressive.target_noise) {
+            stop = "target_noise";
+            break;
+        }
+
+        auto pass_begin = high_resolution_clock::now();
+        unique_ptr<Sampler> sampler(_sampler->get_pass_sampler(std::min(pass_spp, spp - completed * pass_spp)));
+        render_pass(scene, sampler.get(), completed);
+        completed++;
+        auto pass_end = high_resolution_clock::now();
+        pass_time = duration<double>(pass_end - pass_begin).count();
+        if (film->has_noise_estimate()) {
+            noise = film->estimate_noise();
+        }
+        if (checkpoints && completed < passes
+                && duration<double>(pass_end - checkpoint_time).count() >= _progressive.checkpoint_interval) {
+            save_checkpoint(passes, completed);
+            checkpoint_time = high_resolution_clock::now();
+        }
+    }
+    if (checkpoints) {
+        if (completed == passes) {
+            remove(_progressive.checkpoint.c_str());
+        } else {
+            save_checkpoint(passes, completed);
+        }
+    }
+
+    cerr << "progressive:{\"passes\":" << passes << ",\"completed\":" << completed << ",\"resumed\":" << resumed
+        << ",\"spp\":" << std::min(spp, completed * pass_spp) << ",\"noise\":";
+    if (std::isfinite(noise)) {
+        cerr << noise;
+    } else {
+        cerr << "null";
+    }
+    cerr << ",\"stop\":\"" << stop << "\"}" << endl;
+}
+
+void SampledRenderer::render(const Scene *scene) const {
+    int res_x = _camera->_film->_xres;
+    int res_y = _camera->_film->_yres;
+
+    TraceScope trace("render", "render");
+    auto begin_time = high_resolution_clock::now();
+    if (_progressive.enabled()) {
+        render_progressive(scene);
+    } else {
+        render_pass(scene, _sampler.get(), 0);
+    }
+    const Film *film = _camera->_film.get();
+    duration<double, std::milli> denoise_time(0.0);
+    if (film->denoiser()) {
+        TraceScope denoise_trace("denoise", "render");
+        auto denoise_begin = high_resolution_clock::now();
+        _camera->_film->denoise();
+        denoise_time = high_resolution_clock::now() - denoise_begin;
     }
     auto end_time = high_resolution_clock::now();
     duration<double, std::milli> elapsed = end_time - begin_time;
 
-    _camera->_film->print_ppm();
     cerr << "resolution:[" << res_x << "," << res_y << "]" << endl;
     cerr << "total_faces:" << scene->total_faces() << endl;
     cerr << "sampler:" << _sampler->to_string() << endl;
     cerr << "thread_tiles:[" << _thread_tiles[0] << "," << _thread_tiles[1] << "]" << endl;
+    if (film->denoiser()) {
+        cerr << "denoiser:" << film->denoiser()->to_string() << endl;
+        cerr << "denoise_time:" << denoise_time.count() << "ms" << endl;
+    }
     cerr << "render_time:" << elapsed.count() << "ms" << endl;
+    MemoryUsage usage;
+    scene->memory_usage(usage);
+    memory_usage(usage);
+    cerr << "memory:" << usage.to_json() << endl;
+#ifdef GILL_STATS
+    cerr << "ray_stats:" << take_merged_stats().to_json() << endl;
+#endif
+}
+
+void SampledRenderer::memory_usage(MemoryUsage &usage) const {
+    Renderer::memory_usage(usage);
+    // Sample batch allocated by each render tile
+    usage.sampler_buffers += _thread_tiles[0] * _thread_tiles[1] * _sampler->max_batch_size() * sizeof(Sample);
+    // Film tiles together cover the image once (not counting the filter margins)
+    const Film *film = _camera->_film.get();
+    usage.film_tiles += film->_pixels.memory_usage()
+        + (film->has_features() ? film->_xres * film->_yres * sizeof(Film::FeaturePixel) : 0);
+    // Shading arena of each render tile (a single block, unless a path needs more)
+    usage.shading_arenas += _thread_tiles[0] * _thread_tiles[1] * MemoryArena::DefaultBlockSize;
 }
 
 }}
@@ -1,6 +1,9 @@
 #ifndef GILL_RENDERER_SAMPLED_H_
 #define GILL_RENDERER_SAMPLED_H_
 
+#include <cstdint>
+#include <string>
+
 #include "core/renderer.h"
 #include "core/camera.h"
 #include "core/scene.h"
@@ -10,15 +13,55 @@ namespace gill { namespace renderer {
 
 using namespace gill::core;
 
+/**
+ * Settings of progressive rendering, where the samples of each pixel are rendered in passes
+ * and the render can stop early or be resumed from a checkpoint.
+ */
+struct ProgressiveOptions {
+    int pass_spp = 0; /// Samples per pixel of each pass (0 renders all samples in a single pass)
+    double time_budget = 0.0; /// Wall-clock budget in seconds; no pass is started that would exceed it (0 = unlimited)
+    float target_noise = 0.f; /// Relative RMS error (see gill::core::Film::estimate_noise) to stop at (0 = disabled)
+    std::string checkpoint; /// File the progress is saved to and resumed from (empty = no checkpoints)
+    double checkpoint_interval = 60.0; /// Minimum time between checkpoints, in seconds
+    uint64_t document_hash = 0; /// Identifies the scene description and overrides of the render in checkpoints
+
+    bool enabled() const { return pass_spp > 0; }
+};
+
 class SampledRenderer : public Renderer {
 public:
     SampledRenderer(std::shared_ptr<Camera> camera, std::shared_ptr<SurfaceIntegrator> surface_integrator,
-            std::shared_ptr<Sampler> sampler, int thread_tiles[2]);
+            std::shared_ptr<Sampler> sampler, int thread_tiles[2], const ProgressiveOptions &progressive = ProgressiveOptions());
     virtual void render(const Scene *scene) const override;
+    virtual void memory_usage(MemoryUsage &usage) const override;
 
 protected:
+    /**
+     * Renders all samples of a sampler, split into the thread tiles.
+     * @param pass Index of the pass, seeding the random number generators of the tiles.
+     */
+    void render_pass(const Scene *scene, Sampler *sampler, int pass) const;
+
+    /**
+     * Renders in passes until all samples are done or a stopping criterion is met, see ProgressiveOptions.
+     */
+    void render_progressive(const Scene *scene) const;
+
+    /**
+     * Restores the film and the number of completed passes from the checkpoint file, if it exists
+     * and matches the current render settings.
+     * @returns Number of completed passes (0 if nothing was restored).
+     */
+    int load_checkpoint(int passes) const;
+
+    /**
+     * Saves the film and the number of completed passes, replacing the checkpoint file atomically.
+     */
+    void save_checkpoint(int passes, int completed) const;
+
     std::shared_ptr<Sampler> _sampler;
     int _thread_tiles[2];
+    ProgressiveOptions _progressive;
 };
 
 }}
@@ -2,6 +2,7 @@
 #include "core/random.h"
 #include "core/math.h"
 
+#include <algorithm>
 #include <sstream>
 
 namespace gill { namespace sampler {
@@ -34,6 +35,14 @@ Sampler * RandomSampler::get_subsampler(int h_tiles, int v_tiles, int i, int j)
     return new RandomSampler(x0, x1, y0, y1, _num_samples / (h_tiles * v_tiles));
 }
 
+int RandomSampler::samples_per_pixel() const {
+    return std::max(1, _num_samples / ((_x_max - _x_min + 1) * (_y_max - _y_min + 1)));
+}
+
+Sampler * RandomSampler::get_pass_sampler(int spp) const {
+    return new RandomSampler(_x_min, _x_max, _y_min, _y_max, spp * (_x_max - _x_min + 1) * (_y_max - _y_min + 1));
+}
+
 string RandomSampler::to_string() const {
     ostringstream desc(ostringstream::ate);
     desc << "random (" << _num_samples << " samples total)";
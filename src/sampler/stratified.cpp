@@ -43,6 +43,14 @@ Sampler * StratifiedSampler::get_subsampler(int h_tiles, int v_tiles, int i, int
     return new StratifiedSampler(x0, x1, y0, y1, _spp);
 }
 
+int StratifiedSampler::samples_per_pixel() const {
+    return _spp;
+}
+
+Sampler * StratifiedSampler::get_pass_sampler(int spp) const {
+    return new StratifiedSampler(_x_min, _x_max, _y_min, _y_max, spp);
+}
+
 string StratifiedSampler::to_string() const {
     ostringstream desc(ostringstream::ate);
     desc << "stratified (" << _spp << " spp)";
@@ -0,0 +1,134 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server/server.h"
+
+namespace gill { namespace server {
+
+using namespace std;
+using namespace std::chrono;
+using namespace gill::core;
+
+string RenderServer::handle(const string &job) {
+    istringstream tokens(job);
+    string token;
+    map<string, string> args;
+    while (tokens >> token) {
+        if (token == "quit") {
+            _stopped = true;
+            return "ok quit";
+        }
+        size_t eq = token.find('=');
+        if (eq == string::npos) {
+            return "error invalid argument '" + token + "'";
+        }
+        args[token.substr(0, eq)] = token.substr(eq + 1);
+    }
+    if (args.empty()) {
+        return "";
+    }
+
+    string scene = args["scene"], output = args["output"], heatmap = args["heatmap"];
+    args.erase("scene");
+    args.erase("output");
+    args.erase("heatmap");
+    if (scene.empty() || output.empty()) {
+        return "error missing scene or output";
+    }
+
+    auto begin_time = high_resolution_clock::now();
+    try {
+        ofstream out(output);
+        if (!out) {
+            return "error cannot open output file";
+        }
+        ofstream heatmap_out;
+        if (!heatmap.empty()) {
+            heatmap_out.open(heatmap);
+            if (!heatmap_out) {
+                return "error cannot open heatmap file";
+            }
+        }
+        _parser.open(scene.c_str());
+        _parser.set_overrides(args);
+        while (auto doc = _parser.next_document()) {
+            auto film = doc->renderer->camera()->_film;
+            if (!heatmap.empty()) {
+                film->enable_heatmap();
+            }
+            doc->renderer->render(doc->scene.get());
+            film->print_ppm(out);
+            if (!heatmap.empty()) {
+                film->print_heatmap_ppm(heatmap_out);
+            }
+        }
+    } catch (const exception &e) {
+        return string("error ") + e.what();
+    }
+    duration<double, std::milli> elapsed = high_resolution_clock::now() - begin_time;
+
+    ostringstream response;
+    response << "ok " << output << " " << elapsed.count();
+    return response.str();
+}
+
+void RenderServer::serve_stdin() {
+    string line;
+    while (!_stopped && getline(cin, line)) {
+        string response = handle(line);
+        if (!response.empty()) {
+            cout << response << endl;
+        }
+    }
+}
+
+void RenderServer::serve_socket(const char *path) {
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        throw std::runtime_error("cannot create socket");
+    }
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(server_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(server_fd, 4) < 0) {
+        close(server_fd);
+        throw std::runtime_error("cannot bind socket");
+    }
+
+    while (!_stopped) {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            continue;
+        }
+        FILE *client = fdopen(client_fd, "r");
+        char *line = nullptr;
+        size_t capacity = 0;
+        while (!_stopped && getline(&line, &capacity, client) > 0) {
+            string response = handle(line);
+            if (!response.empty()) {
+                response += "\n";
+                if (write(client_fd, response.c_str(), response.size()) < 0) {
+                    break;
+                }
+            }
+        }
+        free(line);
+        fclose(client);
+    }
+
+    close(server_fd);
+    unlink(path);
+}
+
+}}
@@ -0,0 +1,51 @@
+#ifndef GILL_SERVER_SERVER_H_
+#define GILL_SERVER_SERVER_H_
+
+#include <string>
+
+#include "core/parser.h"
+
+namespace gill { namespace server {
+
+/**
+ * Long-running render service keeping loaded meshes and accelerators in memory between jobs.
+ *
+ * Jobs are single lines of whitespace-separated 'key=value' pairs, for example:
+ * @code
+ * scene=bunny.yaml output=bunny.ppm spp=16 position=0,0.25,-0.25 target=0,0.1,0.1
+ * @endcode
+ * The 'scene' and 'output' keys are required, 'heatmap' optionally names a file for the traversal-cost
+ * heatmap (see gill::core::Film::print_heatmap_ppm); all other keys are passed to
+ * gill::core::Parser::set_overrides. Every job is answered with a single line,
+ * either 'ok <output> <milliseconds>' or 'error <message>'. The 'quit' line stops the server.
+ */
+class RenderServer {
+public:
+    /**
+     * Processes jobs from the standard input, writing responses to the standard output.
+     */
+    void serve_stdin();
+
+    /**
+     * Processes jobs from clients connecting to a local Unix domain socket.
+     * @param path Filesystem path of the socket.
+     */
+    void serve_socket(const char *path);
+
+    /**
+     * Renders a single job.
+     * @param job Job description.
+     * @returns Response line (without the trailing newline).
+     */
+    std::string handle(const std::string &job);
+
+    bool stopped() const { return _stopped; }
+
+protected:
+    gill::core::Parser _parser;
+    bool _stopped = false;
+};
+
+}}
+
+#endif
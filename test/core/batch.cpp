@@ -0,0 +1,111 @@
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "core/batch.h"
+
+using namespace gill::core;
+
+/** Defined in test/renderer/sampled.cpp. */
+float mean_radiance(const Film &film);
+
+/**
+ * Writes documents rendering the inside of emissive spheres of decreasing brightness (1, 1/2, 1/4, ...).
+ * @returns Path of the YAML file.
+ */
+std::string write_batch(int num_documents) {
+    std::ostringstream yaml;
+    float color = 1.f;
+    for (int i = 0; i < num_documents; ++i, color *= 0.5f) {
+        yaml << (i > 0 ? "---\n" : "")
+            << "scene:\n"
+            << "  primitives:\n"
+            << "    - geometry: !sphere { radius: 10.0 }\n"
+            << "      material: !emissive { color: [" << color << ", " << color << ", " << color << "] }\n"
+            << "      transform: !translate { delta: [0.0, 0.0, 0.0] }\n"
+            << "renderer: !sampled\n"
+            << "  camera: !perspective\n"
+            << "    transform: !look_at { position: [0.0, 0.0, -1.0], target: [0.0, 0.0, 0.0] }\n"
+            << "    field_of_view: 60.0\n"
+            << "    film:\n"
+            << "      resolution: [32, 32]\n"
+            << "      filter: !box { window: [1, 1] }\n"
+            << "  sampler: !stratified\n"
+            << "    samples_per_pixel: 4\n"
+            << "  surface_integrator: !path\n"
+            << "    max_depth: 1\n"
+            << "  thread_tiles: [4, 4]\n";
+    }
+    std::string filename = ::testing::TempDir() + "gill_batch.yaml";
+    std::ofstream(filename) << yaml.str();
+    return filename;
+}
+
+/** Outputs of a rendered document, as seen by the document writer. */
+struct BatchOutput {
+    float radiance;
+    bool heatmap;
+    std::thread::id thread;
+};
+
+/**
+ * Renders the documents of write_batch sequentially (negative budget) or pipelined, with heatmaps.
+ * @returns Outputs of the documents, in the order they were written.
+ */
+std::vector<BatchOutput> render_batch(int num_documents, float budget) {
+    std::string filename = write_batch(num_documents);
+    Parser parser(filename.c_str());
+    std::vector<BatchOutput> outputs;
+    auto write = [&outputs](const Parser::Document &doc) {
+        auto film = doc.renderer->camera()->_film;
+        outputs.push_back({ mean_radiance(*film), film->has_heatmap(), std::this_thread::get_id() });
+    };
+    if (budget < 0.f) {
+        render_sequential(parser, true, write);
+    } else {
+        render_pipelined(parser, budget, true, write);
+    }
+    return outputs;
+}
+
+TEST(BatchTest, EstimatedSize) {
+    std::string filename = write_batch(1);
+    Parser parser(filename.c_str());
+    auto doc = parser.next_document();
+    float size = estimated_size(*doc);
+    EXPECT_GE(size, 32 * 32 * sizeof(Film::Pixel) / (1024.f * 1024.f));
+    EXPECT_LT(size, 1.f);
+}
+
+TEST(BatchTest, PipelinedMatchesSequential) {
+    const int NumDocuments = 4;
+    std::vector<BatchOutput> sequential = render_batch(NumDocuments, -1.f);
+    ASSERT_EQ(sequential.size(), (size_t)NumDocuments);
+    // A budget of zero never prepares the next document in the background, a large one always does
+    for (float budget : { 0.f, 1024.f }) {
+        std::vector<BatchOutput> pipelined = render_batch(NumDocuments, budget);
+        ASSERT_EQ(pipelined.size(), (size_t)NumDocuments) << "budget " << budget;
+        float color = 1.f;
+        for (int i = 0; i < NumDocuments; ++i, color *= 0.5f) {
+            // Documents are written in order, each after its own render
+            EXPECT_NEAR(sequential[i].radiance, color, 0.05f * color) << "document " << i;
+            EXPECT_NEAR(pipelined[i].radiance, sequential[i].radiance, 0.05f * color) << "document " << i
+                << ", budget " << budget;
+            EXPECT_TRUE(sequential[i].heatmap);
+            EXPECT_TRUE(pipelined[i].heatmap);
+            // Only the pipelined outputs are written asynchronously
+            EXPECT_EQ(sequential[i].thread, std::this_thread::get_id());
+            EXPECT_NE(pipelined[i].thread, std::this_thread::get_id());
+        }
+    }
+}
+
+TEST(BatchTest, EmptyInput) {
+    std::string filename = ::testing::TempDir() + "gill_batch_empty.yaml";
+    std::ofstream(filename) << "";
+    Parser parser(filename.c_str());
+    int written = 0;
+    render_pipelined(parser, 1024.f, false, [&written](const Parser::Document &) { ++written; });
+    EXPECT_EQ(written, 0);
+}
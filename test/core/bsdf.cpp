@@ -0,0 +1,94 @@
+#include <cmath>
+#include "gtest/gtest.h"
+#include "core/bsdf.h"
+#include "core/fresnel.h"
+#include "core/material.h"
+#include "core/memory.h"
+#include "core/random.h"
+#include "material/matte.h"
+
+using namespace gill::core;
+using namespace gill::material;
+
+const int NumSamples = 65536;
+
+/**
+ * Checks that the density and value returned by BSDF::sample for non-specular directions match BSDF::pdf
+ * and BSDF::evaluate, for outgoing directions on both sides of the surface.
+ */
+void check_sample_pdf(const BSDF &bsdf) {
+    RNG rng(1234);
+    for (int i = 0; i < 1024; ++i) {
+        Vector wo = normalize(Vector(random_float(rng, -1.f, 1.f), random_float(rng, -1.f, 1.f), random_float(rng, -1.f, 1.f)));
+        Vector wi;
+        float pdf;
+        BxDF::Type type;
+        Spectrum f = bsdf.sample(wo, wi, random_float(rng, 0.f, 1.f), random_float(rng, 0.f, 1.f),
+            random_float(rng, 0.f, 1.f), &pdf, &type);
+        if (pdf == 0.f || (static_cast<int>(type) & static_cast<int>(BxDF::Type::Specular)) != 0) {
+            continue;
+        }
+        EXPECT_NEAR(pdf, bsdf.pdf(wo, wi), 1e-5f * pdf);
+        Spectrum expected = bsdf.evaluate(wo, wi);
+        EXPECT_NEAR(f[0], expected[0], 1e-5f);
+    }
+}
+
+/**
+ * @returns Monte Carlo estimate of the directional albedo (integral of f * |cos| over the sphere) for given 'wo'.
+ */
+Spectrum estimate_albedo(const BSDF &bsdf, const Vector &wo) {
+    RNG rng(4321);
+    Spectrum sum(0.f);
+    for (int i = 0; i < NumSamples; ++i) {
+        Vector wi;
+        float pdf;
+        Spectrum f = bsdf.sample(wo, wi, random_float(rng, 0.f, 1.f), random_float(rng, 0.f, 1.f),
+            random_float(rng, 0.f, 1.f), &pdf);
+        if (pdf > 0.f) {
+            sum += f * (abs_cos_theta(wi) / pdf);
+        }
+    }
+    return sum / (float)NumSamples;
+}
+
+TEST(BSDFTest, SamplePdfMatchesPdf) {
+    MemoryArena arena;
+    BSDF lambertian;
+    lambertian.add(ARENA_ALLOC(arena, LambertianReflection)(Spectrum(0.5f)));
+    check_sample_pdf(lambertian);
+
+    // Non-specular directions may come from either function, and specular ones have no density in BSDF::pdf
+    BSDF mixed;
+    mixed.add(ARENA_ALLOC(arena, LambertianReflection)(Spectrum(0.3f)));
+    mixed.add(ARENA_ALLOC(arena, BRDFuncToBTDFunc)(ARENA_ALLOC(arena, LambertianReflection)(Spectrum(0.2f))));
+    mixed.add(ARENA_ALLOC(arena, SpecularReflection)(ARENA_ALLOC(arena, Fresnel)(), Spectrum(1.f)));
+    check_sample_pdf(mixed);
+    // Each function contributes its own albedo, although only one of them is sampled at a time
+    EXPECT_NEAR(estimate_albedo(mixed, normalize(Vector(0.5f, 0.f, 1.f)))[0], 1.5f, 0.02f);
+}
+
+TEST(BSDFTest, MatteAlbedo) {
+    MatteMaterial matte(RGB(0.25f, 0.5f, 0.75f));
+    MaterialTable materials;
+    MaterialId id = materials.add(&matte);
+    RNG rng(1);
+    SampledWavelengths wavelengths = SampledWavelengths::sample(rng);
+    SurfaceInteraction si;
+    si.n = Normal(0.f, 0.f, 1.f);
+    MemoryArena arena;
+    const BSDF *bsdf = materials.bsdf(id, si, wavelengths, arena);
+    ASSERT_NE(bsdf, nullptr);
+
+    Spectrum reflectance = from_rgb(RGB(0.25f, 0.5f, 0.75f), wavelengths, ColorType::Reflectance);
+    for (const Vector &wo : { Vector(0.f, 0.f, 1.f), normalize(Vector(1.f, 0.f, 0.2f)), normalize(Vector(0.f, 1.f, -1.f)) }) {
+        Spectrum albedo = estimate_albedo(*bsdf, wo);
+        EXPECT_NEAR(albedo[0], reflectance[0], 1e-3f);
+        // Lambertian reflection scatters to the side of 'wo' only
+        Vector wi;
+        float pdf;
+        bsdf->sample(wo, wi, 0.3f, 0.7f, 0.5f, &pdf);
+        EXPECT_TRUE(same_hemisphere(wo, wi));
+        EXPECT_NEAR(pdf, abs_cos_theta(wi) * InvPi, 1e-5f);
+    }
+}
@@ -0,0 +1,63 @@
+#include <cmath>
+#include "gtest/gtest.h"
+#include "core/filter.h"
+#include "core/montecarlo.h"
+#include "filter/box.h"
+#include "filter/gaussian.h"
+#include "filter/mitchell.h"
+#include "filter/triangle.h"
+
+using namespace gill::core;
+using namespace gill::filter;
+
+TEST(Distribution1DTest, Sample) {
+    const float values[4] = { 1.f, 0.f, 3.f, 4.f };
+    Distribution1D distribution(values, 4);
+    EXPECT_FLOAT_EQ(distribution.integral(), 2.f);
+    float pdf;
+    int offset;
+    // CDF: 0, 0.125, 0.125, 0.5, 1
+    EXPECT_FLOAT_EQ(distribution.sample(0.0625f, &pdf, &offset), 0.125f);
+    EXPECT_EQ(offset, 0);
+    EXPECT_FLOAT_EQ(pdf, 0.5f);
+    EXPECT_FLOAT_EQ(distribution.sample(0.3125f, &pdf, &offset), 0.625f);
+    EXPECT_EQ(offset, 2);
+    EXPECT_FLOAT_EQ(pdf, 1.5f);
+    EXPECT_FLOAT_EQ(distribution.sample(0.75f, &pdf, &offset), 0.875f);
+    EXPECT_EQ(offset, 3);
+    EXPECT_FLOAT_EQ(pdf, 2.f);
+}
+
+TEST(Distribution1DTest, Zero) {
+    const float values[2] = { 0.f, 0.f };
+    Distribution1D distribution(values, 2);
+    float pdf;
+    EXPECT_FLOAT_EQ(distribution.sample(0.25f, &pdf), 0.25f);
+    EXPECT_FLOAT_EQ(pdf, 0.f);
+}
+
+/**
+ * Averages the weights of a stratified grid of samples of a filter, and checks that the offsets lie
+ * within the filter window.
+ */
+float mean_filter_weight(const Filter &filter) {
+    const int n = 256;
+    FilterSampler sampler(filter);
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            float dx, dy;
+            sum += sampler.sample((j + 0.5f) / n, (i + 0.5f) / n, dx, dy);
+            EXPECT_LE(std::abs(dx), filter.width());
+            EXPECT_LE(std::abs(dy), filter.height());
+        }
+    }
+    return sum / (n * n);
+}
+
+TEST(FilterSamplerTest, MeanWeight) {
+    EXPECT_NEAR(mean_filter_weight(BoxFilter(0.5f, 0.5f)), 1.f, 1e-3f);
+    EXPECT_NEAR(mean_filter_weight(TriangleFilter(2.f, 2.f)), 1.f, 1e-3f);
+    EXPECT_NEAR(mean_filter_weight(GaussianFilter(2.f, 2.f, 2.f)), 1.f, 1e-3f);
+    EXPECT_NEAR(mean_filter_weight(MitchellFilter(2.f, 2.f, 1.f / 3.f, 1.f / 3.f)), 1.f, 1e-2f);
+}
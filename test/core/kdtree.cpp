@@ -0,0 +1,166 @@
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+#include "core/kdtree.h"
+
+using namespace gill::core;
+
+/** Bounds of the i-th of a row of boxes along the X axis, with gaps between them. */
+BBox row_box(uint32_t i) {
+    return BBox(Point(i, 0.f, 0.f), Point(i + 0.8f, 1.f, 1.f));
+}
+
+/**
+ * Builds a kD-tree over a row of boxes (see row_box).
+ */
+std::unique_ptr<KdTree> box_row_tree(uint32_t count) {
+    return std::unique_ptr<KdTree>(new KdTree(count, 80.f, 10.f, 1, 32, row_box,
+        [](uint32_t i, const Ray &ray, float &t, Intersection *isec) {
+            float tmin, tmax;
+            if (!row_box(i).intersects(ray, tmin, tmax) || tmin >= t) {
+                return false;
+            }
+            t = tmin;
+            isec->face = i;
+            return true;
+        }));
+}
+
+/** Shoots a ray along the X axis through all the boxes, hitting the first one. */
+bool intersect_row(KdTree &tree) {
+    Ray ray(Point(-1.f, 0.5f, 0.5f), Vector(1.f, 0.f, 0.f));
+    float t = Infinity;
+    Intersection isec;
+    bool hit = tree.intersect(ray, t, &isec);
+    EXPECT_EQ(isec.face, 0u);
+    EXPECT_NEAR(t, 1.f, 1e-5f);
+    return hit;
+}
+
+TEST(KdTreeTest, TraversalCost) {
+    auto tree = box_row_tree(16);
+    TraversalCost cost = { 0, 0 };
+    {
+        TraversalCostScope scope(&cost);
+        ASSERT_TRUE(intersect_row(*tree));
+    }
+    EXPECT_GT(cost.nodes, 0u);
+    EXPECT_GT(cost.tests, 0u);
+    // The closest box is found without visiting every node or testing every box
+    EXPECT_LT(cost.nodes, 2u * 16);
+    EXPECT_LT(cost.tests, 16u);
+
+    // Costs accumulate within a scope
+    TraversalCost twice = { 0, 0 };
+    {
+        TraversalCostScope scope(&twice);
+        intersect_row(*tree);
+        intersect_row(*tree);
+        // Rays missing the tree bounds are free
+        float t = Infinity;
+        Intersection isec;
+        EXPECT_FALSE(tree->intersect(Ray(Point(-1.f, 5.f, 0.5f), Vector(1.f, 0.f, 0.f)), t, &isec));
+    }
+    EXPECT_EQ(twice.nodes, 2 * cost.nodes);
+    EXPECT_EQ(twice.tests, 2 * cost.tests);
+}
+
+TEST(KdTreeTest, TraversalCostScopes) {
+    auto tree = box_row_tree(16);
+    TraversalCost single = { 0, 0 }, outer = { 0, 0 };
+    {
+        TraversalCostScope scope(&single);
+        intersect_row(*tree);
+    }
+    // Traversals outside of scopes are not recorded
+    intersect_row(*tree);
+    {
+        TraversalCostScope scope(&outer);
+        {
+            // Nested scopes redirect (or disable) the accounting, and restore the outer one when they end
+            TraversalCostScope disabled(nullptr);
+            intersect_row(*tree);
+        }
+        intersect_row(*tree);
+        // Other threads are not recorded
+        std::thread([&tree]() { intersect_row(*tree); }).join();
+    }
+    intersect_row(*tree);
+    EXPECT_EQ(outer.nodes, single.nodes);
+    EXPECT_EQ(outer.tests, single.tests);
+}
+
+/**
+ * @returns Numeric value of a key in a JSON object, or a negative value if the key is missing.
+ */
+double json_number(const std::string &json, const std::string &key) {
+    size_t pos = json.find("\"" + key + "\":");
+    return pos == std::string::npos ? -1.0 : std::atof(json.c_str() + pos + key.size() + 3);
+}
+
+/**
+ * @returns Sum of the counts of a histogram in a JSON object.
+ */
+int json_histogram_sum(const std::string &json, const std::string &key) {
+    size_t pos = json.find("\"" + key + "\":[");
+    EXPECT_NE(pos, std::string::npos) << key << " in " << json;
+    int sum = 0;
+    const char *p = json.c_str() + pos + key.size() + 4;
+    while (*p != ']') {
+        char *end;
+        sum += std::strtol(p, &end, 10);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return sum;
+}
+
+TEST(KdTreeTest, Analyze) {
+    auto tree = box_row_tree(16);
+    std::string metrics = tree->analyze(1000, 1);
+    EXPECT_EQ(metrics.find("{\"params\":{\"isec_cost\":80,\"trav_cost\":10,\"max_geoms\":1,\"max_depth\":32},"
+        "\"tuned\":false,"), 0u) << metrics;
+    EXPECT_EQ(json_number(metrics, "geometries"), 16.0);
+    EXPECT_GT(json_number(metrics, "sah_cost"), 0.0);
+
+    // Each leaf holds at most one box, and the disjoint boxes are never duplicated
+    int leaves = json_number(metrics, "leaves");
+    EXPECT_GE(leaves, 16);
+    EXPECT_EQ(json_number(metrics, "nodes"), 2 * leaves - 1);
+    EXPECT_EQ(json_histogram_sum(metrics, "leaf_depths"), leaves);
+    EXPECT_EQ(json_histogram_sum(metrics, "leaf_sizes"), leaves);
+    EXPECT_EQ(json_number(metrics, "refs"), 16.0);
+    EXPECT_EQ(json_number(metrics, "duplication_factor"), 1.0);
+    double empty = json_number(metrics, "empty_leaf_ratio");
+    EXPECT_NEAR(empty, (leaves - 16.0) / leaves, 1e-5);
+
+    // All rays aim at the bounds of the row, mostly at the boxes
+    EXPECT_EQ(json_number(metrics, "rays"), 1000.0);
+    double hit_rate = json_number(metrics, "hit_rate");
+    EXPECT_GT(hit_rate, 0.5);
+    EXPECT_LE(hit_rate, 1.0);
+    EXPECT_GE(json_number(metrics, "nodes_per_ray"), 1.0);
+    EXPECT_GT(json_number(metrics, "tests_per_ray"), 0.0);
+
+    // Rays are reproducible by seed, and optional
+    EXPECT_EQ(tree->analyze(1000, 1), metrics);
+    std::string static_metrics = tree->analyze(0, 1);
+    EXPECT_EQ(json_number(static_metrics, "rays"), -1.0);
+    EXPECT_EQ(json_number(static_metrics, "hit_rate"), -1.0);
+    EXPECT_EQ(json_number(static_metrics, "leaves"), leaves);
+}
+
+TEST(KdTreeTest, AnalyzeOverlapping) {
+    // Boxes spanning the whole row overlap all the others, so they are referenced from several leaves
+    auto tree = std::unique_ptr<KdTree>(new KdTree(8, 80.f, 10.f, 1, 32,
+        [](uint32_t i) { return i % 2 ? BBox(Point(0.f), Point(7.8f, 1.f, 1.f)) : row_box(i); },
+        [](uint32_t, const Ray &, float &, Intersection *) { return false; }));
+    std::string metrics = tree->analyze(100, 1);
+    EXPECT_EQ(json_number(metrics, "geometries"), 8.0);
+    EXPECT_GT(json_number(metrics, "refs"), 8.0);
+    EXPECT_NEAR(json_number(metrics, "duplication_factor"), json_number(metrics, "refs") / 8.0, 1e-5);
+    EXPECT_EQ(json_number(metrics, "hit_rate"), 0.0);
+    // Every ray is tested against the overlapping boxes
+    EXPECT_GE(json_number(metrics, "tests_per_ray"), 4.0);
+}
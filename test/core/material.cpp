@@ -0,0 +1,113 @@
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+#include "core/material.h"
+#include "core/memory.h"
+#include "core/random.h"
+#include "material/emissive.h"
+#include "material/glass.h"
+#include "material/matte.h"
+#include "material/mirror.h"
+
+using namespace gill::core;
+using namespace gill::material;
+
+TEST(MaterialTableTest, AddAndLookup) {
+    MatteMaterial matte(RGB(0.5f, 0.5f, 0.5f));
+    MirrorMaterial mirror(RGB(0.9f, 0.9f, 0.9f));
+    GlassMaterial glass(RGB(1.f, 1.f, 1.f), 1.33f, 0.01f);
+    MaterialTable materials;
+    EXPECT_EQ(materials.add(&matte), 0);
+    EXPECT_EQ(materials.add(&mirror), 1);
+    EXPECT_EQ(materials.add(&glass), 2);
+    // Materials shared by several primitives keep their ID
+    EXPECT_EQ(materials.add(&mirror), 1);
+    EXPECT_EQ(materials.add(&matte), 0);
+    EXPECT_EQ(materials.size(), 3u);
+
+    EXPECT_EQ(materials[0].kind, MaterialKind::Matte);
+    EXPECT_EQ(materials[0].color, RGB(0.5f, 0.5f, 0.5f));
+    EXPECT_EQ(materials[1].kind, MaterialKind::Mirror);
+    EXPECT_EQ(materials[1].color, RGB(0.9f, 0.9f, 0.9f));
+    EXPECT_EQ(materials[2].kind, MaterialKind::Glass);
+    EXPECT_FLOAT_EQ(materials[2].eta, 1.33f);
+    EXPECT_FLOAT_EQ(materials[2].dispersion, 0.01f);
+}
+
+TEST(MaterialTableTest, TooManyMaterials) {
+    std::vector<MatteMaterial> mattes(MaterialTable::MaxMaterials + 1, MatteMaterial(RGB(0.5f, 0.5f, 0.5f)));
+    MaterialTable materials;
+    for (size_t i = 0; i < MaterialTable::MaxMaterials; ++i) {
+        ASSERT_EQ(materials.add(&mattes[i]), (MaterialId)i);
+    }
+    EXPECT_THROW(materials.add(&mattes.back()), std::runtime_error);
+    EXPECT_EQ(materials.size(), (size_t)MaterialTable::MaxMaterials);
+    // Materials already in a full table are still found
+    EXPECT_EQ(materials.add(&mattes[7]), 7);
+}
+
+/**
+ * Samples a BSDF at normal incidence with given choice of function.
+ * @returns Throughput (value times cosine over density) of the sampled direction.
+ */
+Spectrum sample_throughput(const BSDF &bsdf, float u3, BxDF::Type &type) {
+    Vector wo(0.f, 0.f, 1.f), wi;
+    float pdf;
+    Spectrum f = bsdf.sample(wo, wi, 0.3f, 0.6f, u3, &pdf, &type);
+    EXPECT_GT(pdf, 0.f);
+    return f * (std::abs(wi.z) / pdf);
+}
+
+/** Compares the first three coefficients of spectra (all of an RGB; most of the hero wavelengths). */
+void expect_near(const Spectrum &a, const Spectrum &b) {
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_NEAR(a[i], b[i], 1e-5f) << "coefficient " << i;
+    }
+}
+
+TEST(MaterialTableTest, BSDFComponents) {
+    EmissiveMaterial light(RGB(1.f, 1.f, 1.f));
+    MatteMaterial matte(RGB(0.25f, 0.5f, 0.75f));
+    MirrorMaterial mirror(RGB(0.9f, 0.8f, 0.7f));
+    GlassMaterial glass(RGB(1.f, 1.f, 1.f), 1.5f);
+    MaterialTable materials;
+    MaterialId ids[] = { materials.add(&light), materials.add(&matte), materials.add(&mirror), materials.add(&glass) };
+    RNG rng(1);
+    SampledWavelengths wavelengths = SampledWavelengths::sample(rng);
+    SurfaceInteraction si;
+    si.n = Normal(0.f, 0.f, 1.f);
+    MemoryArena arena;
+    BxDF::Type type;
+
+    EXPECT_EQ(materials.bsdf(ids[0], si, wavelengths, arena), nullptr);
+
+    // Matte: a single Lambertian reflection with the matte's reflectance
+    const BSDF *bsdf = materials.bsdf(ids[1], si, wavelengths, arena);
+    ASSERT_NE(bsdf, nullptr);
+    EXPECT_EQ(bsdf->num_components(), 1);
+    Spectrum reflectance = from_rgb(RGB(0.25f, 0.5f, 0.75f), wavelengths, ColorType::Reflectance);
+    Spectrum throughput = sample_throughput(*bsdf, 0.5f, type);
+    EXPECT_EQ(static_cast<int>(type), static_cast<int>(BxDF::Type::Reflection) | static_cast<int>(BxDF::Type::Diffuse));
+    expect_near(throughput, reflectance);
+
+    // Mirror: a single specular reflection, without Fresnel attenuation
+    bsdf = materials.bsdf(ids[2], si, wavelengths, arena);
+    ASSERT_NE(bsdf, nullptr);
+    EXPECT_EQ(bsdf->num_components(), 1);
+    reflectance = from_rgb(RGB(0.9f, 0.8f, 0.7f), wavelengths, ColorType::Reflectance);
+    throughput = sample_throughput(*bsdf, 0.5f, type);
+    EXPECT_EQ(static_cast<int>(type), static_cast<int>(BxDF::Type::Reflection) | static_cast<int>(BxDF::Type::Specular));
+    expect_near(throughput, reflectance);
+
+    // Glass: specular reflection and transmission
+    bsdf = materials.bsdf(ids[3], si, wavelengths, arena);
+    ASSERT_NE(bsdf, nullptr);
+    EXPECT_EQ(bsdf->num_components(), 2);
+    sample_throughput(*bsdf, 0.25f, type);
+    EXPECT_EQ(static_cast<int>(type), static_cast<int>(BxDF::Type::Reflection) | static_cast<int>(BxDF::Type::Specular));
+    sample_throughput(*bsdf, 0.75f, type);
+    EXPECT_EQ(static_cast<int>(type), static_cast<int>(BxDF::Type::Transmission) | static_cast<int>(BxDF::Type::Specular));
+    // No non-specular scattering
+    EXPECT_TRUE(is_black(bsdf->evaluate(Vector(0.f, 0.f, 1.f), normalize(Vector(1.f, 0.f, 1.f)))));
+}
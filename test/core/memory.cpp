@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "core/bsdf.h"
+#include "core/memory.h"
+
+using namespace gill::core;
+
+TEST(MemoryArenaTest, Alignment) {
+    MemoryArena arena(1024);
+    const size_t sizes[] = { 1, 3, 8, 17, 100, 1 };
+    for (size_t size : sizes) {
+        void *ptr = arena.alloc(size);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignof(std::max_align_t), 0u);
+        memset(ptr, 0xff, size);
+    }
+}
+
+TEST(MemoryArenaTest, BlockGrowth) {
+    MemoryArena arena(1024);
+    EXPECT_EQ(arena.total_allocated(), 0u);
+    char *first = static_cast<char *>(arena.alloc(512));
+    char *second = static_cast<char *>(arena.alloc(512));
+    EXPECT_EQ(second, first + 512);
+    EXPECT_EQ(arena.total_allocated(), 1024u);
+    // A full block is followed by another of the default size
+    arena.alloc(16);
+    EXPECT_EQ(arena.total_allocated(), 2048u);
+    // Allocations larger than the default size get a block of their own size
+    arena.alloc(4096);
+    EXPECT_EQ(arena.total_allocated(), 2048u + 4096u);
+}
+
+TEST(MemoryArenaTest, ResetReusesBlocks) {
+    MemoryArena arena(1024);
+    auto allocate = [&arena]() {
+        for (int i = 0; i < 10; ++i) {
+            arena.alloc(300);
+        }
+        arena.alloc(2000);
+    };
+    // Blocks are reused in a different order after the first reset, so a large allocation may need one more block
+    allocate();
+    arena.reset();
+    allocate();
+    size_t total = arena.total_allocated();
+    for (int i = 0; i < 5; ++i) {
+        arena.reset();
+        allocate();
+        EXPECT_EQ(arena.total_allocated(), total);
+    }
+    // After a reset, allocations start over in a kept block
+    arena.reset();
+    char *first = static_cast<char *>(arena.alloc(16));
+    char *second = static_cast<char *>(arena.alloc(16));
+    EXPECT_EQ(second, first + 16);
+    EXPECT_EQ(arena.total_allocated(), total);
+}
+
+TEST(MemoryArenaTest, BSDFOverflow) {
+    MemoryArena arena;
+    BSDF *bsdf = ARENA_ALLOC(arena, BSDF)();
+    int max_bxdfs = BSDF::MaxBxDFs;
+    for (int i = 0; i < max_bxdfs; ++i) {
+        bsdf->add(ARENA_ALLOC(arena, LambertianReflection)(Spectrum(0.5f)));
+    }
+    EXPECT_EQ(bsdf->num_components(), max_bxdfs);
+    EXPECT_THROW(bsdf->add(ARENA_ALLOC(arena, LambertianReflection)(Spectrum(0.5f))), std::runtime_error);
+    EXPECT_EQ(bsdf->num_components(), max_bxdfs);
+}
@@ -0,0 +1,90 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "core/parser.h"
+
+using namespace gill::core;
+
+const char *InvalidThenValid =
+    "scene:\n"
+    "  primitives:\n"
+    "    - geometry: !sphere { radius: 1.0 }\n"
+    "      material: !unknown { color: [1.0, 1.0, 1.0] }\n"
+    "      transform: !translate { delta: [0.0, 0.0, 0.0] }\n"
+    "---\n"
+    "scene:\n"
+    "  primitives:\n"
+    "    - geometry: !sphere { radius: 2.0 }\n"
+    "      material: !emissive { color: [1.0, 1.0, 1.0] }\n"
+    "      transform: !translate { delta: [0.0, 0.0, 0.0] }\n";
+
+TEST(ParserTest, ReuseAfterInvalidDocument) {
+    std::string filename = ::testing::TempDir() + "gill_parser.yaml";
+    std::ofstream(filename) << InvalidThenValid;
+    Parser parser(filename.c_str());
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_THROW(parser.next_document(), std::runtime_error);
+        // The geometry cached for the failed document must not be reused for the same node of the next one
+        auto doc = parser.next_document();
+        ASSERT_TRUE(doc && doc->scene);
+        ASSERT_EQ(doc->scene->primitives().size(), 1u);
+        EXPECT_FLOAT_EQ(doc->scene->primitives()[0].bounds().max.x, 2.f);
+        EXPECT_FALSE(parser.next_document());
+        // Reopening resets the parser, as the render server does for each job
+        parser.open(filename.c_str());
+    }
+}
+
+/**
+ * Two instances of the same mesh and material, translated by +/-offset along x.
+ */
+std::string mesh_instances(const std::string &url, float offset) {
+    std::ostringstream yaml;
+    yaml << "scene:\n"
+        << "  primitives:\n"
+        << "    - geometry: &mesh !mesh { url: " << url << " }\n"
+        << "      material: &matte !matte { color: [0.5, 0.5, 0.5] }\n"
+        << "      transform: !translate { delta: [" << offset << ", 0.0, 0.0] }\n"
+        << "    - geometry: *mesh\n"
+        << "      material: *matte\n"
+        << "      transform: !translate { delta: [" << -offset << ", 0.0, 0.0] }\n";
+    return yaml.str();
+}
+
+TEST(ParserTest, FlattenedMeshPerTransforms) {
+    std::string url = ::testing::TempDir() + "gill_triangle.obj";
+    std::ofstream(url) << "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+    std::string filename = ::testing::TempDir() + "gill_instances.yaml";
+    std::ofstream(filename) << mesh_instances(url, 2.f) << "---\n" << mesh_instances(url, 3.f) << "---\n"
+        << mesh_instances(url, 2.f);
+    Parser parser(filename.c_str());
+    ::testing::internal::CaptureStderr();
+    auto first = parser.next_document();
+    auto second = parser.next_document();
+    auto third = parser.next_document();
+    std::string log = ::testing::internal::GetCapturedStderr();
+    for (auto &doc : { first, second, third }) {
+        ASSERT_EQ(doc->scene->primitives().size(), 1u);
+    }
+
+    // Instances baked in world space, with the transforms of each document
+    const Primitive &baked = first->scene->primitives()[0];
+    EXPECT_FLOAT_EQ(baked.bounds().min.x, -2.f);
+    EXPECT_FLOAT_EQ(baked.bounds().max.x, 3.f);
+    EXPECT_NE(second->scene->primitives()[0].geometry(), baked.geometry());
+    EXPECT_FLOAT_EQ(second->scene->primitives()[0].bounds().min.x, -3.f);
+    EXPECT_FLOAT_EQ(second->scene->primitives()[0].bounds().max.x, 4.f);
+    // The same transforms reuse the baked mesh
+    EXPECT_EQ(third->scene->primitives()[0].geometry(), baked.geometry());
+    EXPECT_NE(log.find("flattened, reused"), std::string::npos) << log;
+}
+
+TEST(ParserTest, UnknownOverride) {
+    std::string filename = ::testing::TempDir() + "gill_parser.yaml";
+    std::ofstream(filename) << InvalidThenValid;
+    Parser parser(filename.c_str());
+    EXPECT_NO_THROW(parser.set_overrides({ { "spp", "4" }, { "pass_spp", "2" }, { "checkpoint_interval", "10" } }));
+    EXPECT_THROW(parser.set_overrides({ { "spp", "4" }, { "pass_sp", "2" } }), std::runtime_error);
+    EXPECT_THROW(parser.set_overrides({ { "progressive", "1" } }), std::runtime_error);
+}
@@ -0,0 +1,39 @@
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+#include "core/perf.h"
+
+using namespace gill::core;
+
+/**
+ * @returns Time of a phase in a perf_report, or a negative value if the phase is missing.
+ */
+double phase_time(const std::string &report, const std::string &phase) {
+    std::string key = "\"" + phase + "\":{\"threads\":1,\"time_ms\":";
+    size_t pos = report.find(key);
+    return pos == std::string::npos ? -1.0 : std::atof(report.c_str() + pos + key.size());
+}
+
+TEST(PerfTest, NestedPhasesAreExclusive) {
+    PerfCounters::set_enabled(true);
+    perf_reset();
+    {
+        PerfScope outer("outer");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        {
+            PerfScope inner("inner");
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    PerfCounters::set_enabled(false);
+    std::string report = perf_report();
+    perf_reset();
+    double outer = phase_time(report, "outer"), inner = phase_time(report, "inner");
+    EXPECT_GE(inner, 100.0) << report;
+    EXPECT_GE(outer, 40.0) << report;
+    // The enclosing phase is paused while the nested one runs
+    EXPECT_LT(outer, 90.0) << report;
+}
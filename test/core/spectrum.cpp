@@ -0,0 +1,53 @@
+#include "gtest/gtest.h"
+#include "core/random.h"
+#include "core/spectrum.h"
+
+using namespace gill::core;
+
+/**
+ * Converts an RGB color into spectra at random wavelengths and back, averaging the (single-sample) RGB estimates.
+ * Reflectances are lit by a white illuminant, as they are seen in renders.
+ */
+RGB round_trip(const RGB &rgb, ColorType type) {
+    const int NumSamples = 65536;
+    RNG rng(1);
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < NumSamples; ++i) {
+        SampledWavelengths wavelengths = SampledWavelengths::sample(rng);
+        Spectrum spectrum = from_rgb(rgb, wavelengths, type);
+        if (type == ColorType::Reflectance) {
+            spectrum *= from_rgb(RGB(1.f, 1.f, 1.f), wavelengths, ColorType::Illuminant);
+        }
+        RGB estimate = to_rgb(spectrum, wavelengths);
+        for (int c = 0; c < 3; ++c) {
+            sum[c] += estimate[c];
+        }
+    }
+    return RGB(sum[0] / NumSamples, sum[1] / NumSamples, sum[2] / NumSamples);
+}
+
+TEST(SpectrumTest, RGBRoundTrip) {
+    const RGB colors[] = { RGB(1.f, 1.f, 1.f), RGB(0.5f, 0.5f, 0.5f), RGB(1.f, 0.f, 0.f), RGB(0.f, 1.f, 0.f),
+        RGB(0.f, 0.f, 1.f) };
+    for (ColorType type : { ColorType::Reflectance, ColorType::Illuminant }) {
+        for (const RGB &color : colors) {
+            RGB result = round_trip(color, type);
+            for (int c = 0; c < 3; ++c) {
+                EXPECT_NEAR(result[c], color[c], 0.05f) << "component " << c << " of " << color[0] << ","
+                    << color[1] << "," << color[2] << (type == ColorType::Reflectance ? " reflectance" : " illuminant");
+            }
+        }
+    }
+}
+
+#ifdef GILL_SPECTRAL
+TEST(SpectrumTest, TerminateSecondary) {
+    RNG rng(1);
+    SampledWavelengths wavelengths = SampledWavelengths::sample(rng);
+    EXPECT_FALSE(wavelengths.secondary_terminated);
+    EXPECT_TRUE(wavelengths.terminate_secondary());
+    EXPECT_TRUE(wavelengths.secondary_terminated);
+    // Only the first termination hands the secondary contributions over to the hero wavelength
+    EXPECT_FALSE(wavelengths.terminate_secondary());
+}
+#endif
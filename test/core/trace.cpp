@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+#include "core/trace.h"
+
+using namespace gill::core;
+
+/**
+ * @returns Line of the event with given name in the output of write_trace, or an empty string if it is missing.
+ */
+std::string trace_event(const std::string &trace, const std::string &name) {
+    std::istringstream lines(trace);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.find("{\"name\":\"" + name + "\"") == 0) {
+            return line;
+        }
+    }
+    return "";
+}
+
+/**
+ * @returns Numeric field of a trace event.
+ */
+double event_field(const std::string &event, const std::string &field) {
+    std::string key = "\"" + field + "\":";
+    size_t pos = event.find(key);
+    EXPECT_NE(pos, std::string::npos) << field << " in " << event;
+    return pos == std::string::npos ? -1.0 : std::atof(event.c_str() + pos + key.size());
+}
+
+TEST(TraceTest, CompleteEvents) {
+    {
+        TraceScope disabled("trace_test_disabled", "test");
+        disabled.arg("ignored", 1.0);
+    }
+    TraceScope::set_enabled(true);
+    {
+        TraceScope outer("trace_test_outer", "test");
+        outer.arg("file", "a \"quoted\" name");
+        outer.arg("count", 3);
+        {
+            TraceScope inner("trace_test_inner", "test");
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        std::thread([]() { TraceScope other("trace_test_thread", "test"); }).join();
+    }
+    TraceScope::set_enabled(false);
+    {
+        TraceScope disabled("trace_test_disabled", "test");
+    }
+    std::ostringstream out;
+    write_trace(out);
+    std::string trace = out.str();
+
+    EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0u);
+    EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+    EXPECT_EQ(trace_event(trace, "trace_test_disabled"), "");
+    std::string outer = trace_event(trace, "trace_test_outer"), inner = trace_event(trace, "trace_test_inner"),
+        other = trace_event(trace, "trace_test_thread");
+    ASSERT_NE(outer, "") << trace;
+    ASSERT_NE(inner, "") << trace;
+    ASSERT_NE(other, "") << trace;
+    EXPECT_NE(outer.find("\"cat\":\"test\",\"ph\":\"X\""), std::string::npos) << outer;
+    EXPECT_NE(outer.find("\"args\":{\"file\":\"a \\\"quoted\\\" name\",\"count\":3}}"), std::string::npos) << outer;
+    EXPECT_NE(inner.find("\"args\":{}}"), std::string::npos) << inner;
+
+    // Nested scopes lie within the enclosing ones, in microseconds
+    double outer_ts = event_field(outer, "ts"), inner_ts = event_field(inner, "ts");
+    double outer_dur = event_field(outer, "dur"), inner_dur = event_field(inner, "dur");
+    EXPECT_GE(inner_dur, 10000.0);
+    EXPECT_LE(outer_ts, inner_ts);
+    EXPECT_LE(inner_ts + inner_dur, outer_ts + outer_dur);
+    // Each thread has its own timeline
+    EXPECT_EQ(event_field(outer, "tid"), event_field(inner, "tid"));
+    EXPECT_NE(event_field(outer, "tid"), event_field(other, "tid"));
+}
+
+TEST(TraceTest, EnabledDuringScope) {
+    {
+        // Scopes started before tracing is enabled are not recorded
+        TraceScope scope("trace_test_started_disabled", "test");
+        TraceScope::set_enabled(true);
+        scope.arg("ignored", 1.0);
+    }
+    TraceScope::set_enabled(false);
+    std::ostringstream out;
+    write_trace(out);
+    EXPECT_EQ(trace_event(out.str(), "trace_test_started_disabled"), "");
+}
@@ -102,3 +102,24 @@ TEST(TransformTest, Inverse) {
     Transform xform2 = *Transform::translate(+1.0, -1.0, 0.0);
     EXPECT_EQ(inverse(xform1), xform2);
 }
+
+TEST(AffineTransformTest, TransformPoint) {
+    Transform xform = *Transform::translate(4.0, 5.0, 6.0) * *Transform::scale(1.0, 2.0, 3.0);
+    AffineTransform affine(xform);
+    Point p(1.0, 2.0, 3.0);
+    EXPECT_EQ(affine(p), xform(p));
+}
+
+TEST(AffineTransformTest, TransformRay) {
+    Transform xform = *Transform::translate(4.0, 5.0, 6.0) * *Transform::scale(1.0, 2.0, 3.0);
+    AffineTransform affine(xform);
+    Ray r(Point(1.0, 2.0, 3.0), Vector(4.0, 5.0, 6.0));
+    EXPECT_EQ(affine(r), xform(r));
+}
+
+TEST(AffineTransformTest, TransformNormal) {
+    Transform xform = *Transform::scale(1.0, 2.0, 3.0);
+    AffineTransform inv(inverse(xform));
+    Normal n(1.0, 2.0, 3.0);
+    EXPECT_EQ(inv.transform_normal(n), xform(n));
+}
@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "core/vector.h"
+#include "core/spectrum.h"
 
 using namespace gill::core;
 
@@ -8,6 +9,21 @@ TEST(VectorTest, Negate) {
     EXPECT_EQ(-v, Vector(-1.0, -2.0, -3.0));
 }
 
+TEST(VectorTest, Index) {
+    Vector v(1.0, 2.0, 3.0);
+    Point p(4.0, 5.0, 6.0);
+    Normal n(7.0, 8.0, 9.0);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(v[i], 1.0 + i);
+        EXPECT_EQ(p[i], 4.0 + i);
+        EXPECT_EQ(n[i], 7.0 + i);
+    }
+    v[0] = 10.0; p[1] = 11.0; n[2] = 12.0;
+    EXPECT_EQ(v, Vector(10.0, 2.0, 3.0));
+    EXPECT_EQ(p, Point(4.0, 11.0, 6.0));
+    EXPECT_EQ(n, Normal(7.0, 8.0, 12.0));
+}
+
 TEST(VectorTest, Compare) {
     Vector v(1.0, 2.0, 3.0);
     EXPECT_EQ(v, v);
@@ -115,3 +131,50 @@ TEST(VectorTest, Distance) {
     Point p2(4.0, 5.0, 6.0);
     EXPECT_FLOAT_EQ(distance(p1, p2), 5.1961522);
 }
+
+/**
+ * Checks the SIMD operators of a spectrum against per-coefficient scalar arithmetic.
+ * RGB is shorter than a single pack, SampledSpectrum spans several packs with a partial last one.
+ */
+template <typename S, int n>
+void check_spectrum_ops() {
+    S a, b;
+    for (int i = 0; i < n; ++i) {
+        a[i] = 1.0 + i;
+        b[i] = 2.0 + 0.5 * i;
+    }
+    S sum = a + b, diff = a - b, prod = a * b, quot = a / b, scaled = a * 3.0, divided = a / 4.0;
+    S clamped = clamp(a, 2.0, 5.0), root = sqrt(a);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_FLOAT_EQ(sum[i], a[i] + b[i]);
+        EXPECT_FLOAT_EQ(diff[i], a[i] - b[i]);
+        EXPECT_FLOAT_EQ(prod[i], a[i] * b[i]);
+        EXPECT_FLOAT_EQ(quot[i], a[i] / b[i]);
+        EXPECT_FLOAT_EQ(scaled[i], a[i] * 3.0f);
+        EXPECT_FLOAT_EQ(divided[i], a[i] / 4.0f);
+        EXPECT_FLOAT_EQ(clamped[i], std::min(std::max(a[i], 2.0f), 5.0f));
+        EXPECT_FLOAT_EQ(root[i], std::sqrt(a[i]));
+    }
+    S c = a;
+    c += b; c -= b; c *= b; c /= b;
+    for (int i = 0; i < n; ++i) {
+        EXPECT_FLOAT_EQ(c[i], a[i]);
+    }
+}
+
+TEST(SpectrumTest, Operators) {
+    check_spectrum_ops<RGB, 3>();
+    check_spectrum_ops<HeroSpectrum, HeroWavelengths>();
+    check_spectrum_ops<SampledSpectrum, SpectrumSamples>();
+}
+
+TEST(SpectrumTest, Black) {
+    SampledSpectrum s;
+    EXPECT_TRUE(is_black(s));
+    // Division by a black spectrum must not leak into the padding
+    EXPECT_TRUE(is_black(s / (s + SampledSpectrum(1.0))));
+    s[SpectrumSamples - 1] = 1.0;
+    EXPECT_FALSE(is_black(s));
+    EXPECT_NE(s, SampledSpectrum());
+    EXPECT_EQ(RGB(1.0) * 2.0, RGB(2.0, 2.0, 2.0));
+}
@@ -0,0 +1,72 @@
+#include <cmath>
+#include "gtest/gtest.h"
+#include "core/random.h"
+#include "denoiser/atrous.h"
+
+using namespace gill::core;
+using namespace gill::denoiser;
+
+/**
+ * Noisy image of two surfaces meeting at x = width / 2: a floor facing up with an illumination of 0.2
+ * on the left, and a wall facing left with an illumination of 0.8 on the right, both with an albedo of 0.5.
+ */
+DenoiserInput noisy_image(int width, int height, float noise) {
+    DenoiserInput input;
+    input.width = width;
+    input.height = height;
+    RNG rng(1234);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            bool wall = x >= width / 2;
+            input.color.push_back(RGB((wall ? 0.8f : 0.2f) * 0.5f * (1.f + random_float(rng, -noise, noise))));
+            input.albedo.push_back(RGB(0.5f));
+            input.normal.push_back(wall ? Vector(-1.f, 0.f, 0.f) : Vector(0.f, 1.f, 0.f));
+            input.depth.push_back(1.f);
+            input.coverage.push_back(1.f);
+            input.variance.push_back(-1.f);
+        }
+    }
+    return input;
+}
+
+float rmse(const DenoiserInput &input, const std::vector<RGB> &image) {
+    double se = 0.0;
+    for (int y = 0; y < input.height; ++y) {
+        for (int x = 0; x < input.width; ++x) {
+            float expected = (x >= input.width / 2 ? 0.8f : 0.2f) * 0.5f;
+            float diff = image[y * input.width + x][0] - expected;
+            se += diff * diff;
+        }
+    }
+    return std::sqrt(se / (input.width * input.height));
+}
+
+TEST(DenoiserTest, Demodulate) {
+    RGB radiance(0.2f, 0.4f, 0.6f), albedo(0.5f, 0.f, 0.25f);
+    RGB illumination = demodulate(radiance, albedo);
+    EXPECT_FLOAT_EQ(illumination[0], 0.4f);
+    EXPECT_FLOAT_EQ(illumination[1], 0.4f);
+    EXPECT_FLOAT_EQ(illumination[2], 2.4f);
+    RGB result = modulate(illumination, albedo);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_FLOAT_EQ(result[i], radiance[i]);
+    }
+}
+
+TEST(DenoiserTest, ReducesNoise) {
+    DenoiserInput input = noisy_image(64, 64, 0.5f);
+    AtrousDenoiser denoiser(5, 4.f, 128.f, 1.f, 0.1f, 2);
+    std::vector<RGB> output;
+    denoiser.denoise(input, output);
+    ASSERT_EQ(output.size(), input.color.size());
+    EXPECT_LT(rmse(input, output), 0.25f * rmse(input, input.color));
+}
+
+TEST(DenoiserTest, PreservesEdges) {
+    DenoiserInput input = noisy_image(64, 64, 0.f);
+    AtrousDenoiser denoiser(5, 4.f, 128.f, 1.f, 0.1f, 2);
+    std::vector<RGB> output;
+    denoiser.denoise(input, output);
+    EXPECT_NEAR(output[32 * 64 + 31][0], 0.1f, 1e-3f);
+    EXPECT_NEAR(output[32 * 64 + 32][0], 0.4f, 1e-3f);
+}
@@ -0,0 +1,200 @@
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "gtest/gtest.h"
+#include "core/bsdf.h"
+#include "core/scene.h"
+#include "core/transform.h"
+#include "geometry/mesh.h"
+#include "material/matte.h"
+
+using namespace gill::core;
+using namespace gill::geometry;
+using namespace gill::material;
+
+/**
+ * Height field over a 2x2 grid of quads, so that a ray coming from above hits a single triangle.
+ * @param vertices Receives the vertices of the mesh.
+ */
+std::shared_ptr<Mesh> height_field(std::vector<Point> &vertices) {
+    vertices.clear();
+    const float heights[9] = { 0.f, 0.2f, 0.1f, 0.3f, 0.5f, 0.2f, 0.f, 0.4f, 0.1f };
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 3; ++x) {
+            vertices.push_back(Point(x, y, heights[y * 3 + x]));
+        }
+    }
+    std::vector<Mesh::Triangle> triangles;
+    for (int y = 0; y < 2; ++y) {
+        for (int x = 0; x < 2; ++x) {
+            int i = y * 3 + x;
+            triangles.push_back({ i, i + 1, i + 4 });
+            triangles.push_back({ i, i + 4, i + 3 });
+        }
+    }
+    return Mesh::from_triangles(vertices, triangles);
+}
+
+/** Instance transformation with a rotation, a non-uniform scale and a translation. */
+std::shared_ptr<Transform> instance_transform() {
+    return Transform::compose({ Transform::translate(1.f, -2.f, 3.f),
+        Transform::rotate(normalize(Vector(1.f, 1.f, 0.f)), 30.f), Transform::scale(2.f, 0.5f, 1.5f) });
+}
+
+void expect_near(const Vector &a, const Vector &b, const char *what) {
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_NEAR(a[i], b[i], 1e-4f) << what << " component " << i;
+    }
+}
+
+/**
+ * Shoots rays at the vertices (just inside of the triangle), edges and interior of every triangle of a mesh
+ * instance, and checks the deferred surface data against the data computed eagerly, during the intersection,
+ * before it was deferred: the point along the ray, the normal of the triangle's edges transformed by the
+ * inverse transposed instance transformation, and the edges transformed into world space.
+ */
+void check_surface_interactions(std::shared_ptr<Transform> ltow) {
+    std::vector<Point> vertices;
+    auto mesh = height_field(vertices);
+    std::vector<Primitive> primitives;
+    primitives.push_back(Primitive(mesh, std::make_shared<MatteMaterial>(RGB(0.5f, 0.5f, 0.5f)), ltow,
+        std::make_shared<Transform>(inverse(*ltow))));
+    Scene scene(primitives);
+    const AffineTransform &to_world = scene.primitives()[0].local_to_world();
+    const AffineTransform &to_local = scene.primitives()[0].world_to_local();
+
+    const float e = 1e-3f;
+    const float uvs[][2] = { { e, e }, { 1.f - 2.f * e, e }, { e, 1.f - 2.f * e }, { 0.5f, e }, { e, 0.5f },
+        { 0.5f, 0.5f - e }, { 1.f / 3.f, 1.f / 3.f }, { 0.2f, 0.7f } };
+    for (uint32_t face = 0; face < mesh->triangles().size(); ++face) {
+        const Mesh::Triangle &tri = mesh->triangles()[face];
+        Point p0 = vertices[tri.i1];
+        Vector e1 = vertices[tri.i2] - p0, e2 = vertices[tri.i3] - p0;
+        Normal local_n = Normal(normalize(cross(e1, e2)));
+        Normal expected_n = normalize(to_local.transform_normal(local_n));
+        for (auto &uv : uvs) {
+            Point local_p = p0 + e1 * uv[0] + e2 * uv[1];
+            Point target = to_world(local_p), origin = to_world(local_p + Vector(0.f, 0.f, 5.f));
+            Ray ray(origin, target - origin);
+            float t = Infinity;
+            Intersection isec;
+            ASSERT_TRUE(scene.intersect(ray, t, &isec)) << "face " << face;
+            ASSERT_EQ(isec.face, face) << "at " << uv[0] << "," << uv[1];
+            EXPECT_NEAR(isec.u, uv[0], 1e-4f);
+            EXPECT_NEAR(isec.v, uv[1], 1e-4f);
+
+            SurfaceInteraction si;
+            scene.compute_surface_interaction(ray, t, isec, si);
+            expect_near(Vector(si.p), Vector(ray(t)), "point");
+            expect_near(Vector(si.p), Vector(target), "point");
+            expect_near(Vector(si.n), Vector(expected_n), "normal");
+            expect_near(si.dpdu, to_world(e1), "dpdu");
+            expect_near(si.dpdv, to_world(e2), "dpdv");
+            EXPECT_NEAR(dot(Vector(si.n), si.dpdu), 0.f, 1e-4f);
+            EXPECT_EQ(si.material, scene.primitives()[0].material_id());
+
+            ShadingFrame frame(si.n), expected_frame(expected_n);
+            expect_near(frame.s, expected_frame.s, "shading s");
+            expect_near(frame.t, expected_frame.t, "shading t");
+            expect_near(frame.n, expected_frame.n, "shading n");
+        }
+    }
+}
+
+TEST(MeshTest, SurfaceInteraction) {
+    check_surface_interactions(std::make_shared<Transform>());
+}
+
+TEST(MeshTest, InstanceSurfaceInteraction) {
+    check_surface_interactions(instance_transform());
+}
+
+TEST(MeshTest, FlattenedInstances) {
+    std::vector<Point> vertices;
+    auto mesh = height_field(vertices);
+    auto material = std::make_shared<MatteMaterial>(RGB(0.5f, 0.5f, 0.5f));
+    std::vector<std::shared_ptr<Transform>> ltows = { instance_transform(), Transform::translate(-4.f, 1.f, 0.5f) };
+    std::vector<Primitive> instances;
+    std::vector<AffineTransform> to_worlds, to_locals;
+    for (auto &ltow : ltows) {
+        auto wtol = std::make_shared<Transform>(inverse(*ltow));
+        instances.push_back(Primitive(mesh, material, ltow, wtol));
+        to_worlds.push_back(*ltow);
+        to_locals.push_back(*wtol);
+    }
+    auto baked = Mesh::from_instances(*mesh, to_worlds, to_locals);
+    EXPECT_EQ(baked->num_faces(), 2 * mesh->num_faces());
+    EXPECT_EQ(baked->num_vertices(), 2 * mesh->num_vertices());
+
+    // The baked mesh is in world space: it is bounded by the transformed vertices, within the instances' bounds
+    BBox bounds;
+    for (auto &to_world : to_worlds) {
+        for (const Point &v : vertices) {
+            bounds += to_world(v);
+        }
+    }
+    BBox baked_bounds = baked->bounds();
+    expect_near(Vector(baked_bounds.min), Vector(bounds.min), "bounds min");
+    expect_near(Vector(baked_bounds.max), Vector(bounds.max), "bounds max");
+    BBox instance_bounds = instances[0].bounds();
+    instance_bounds += instances[1].bounds();
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_GE(baked_bounds.min[i], instance_bounds.min[i] - 1e-4f);
+        EXPECT_LE(baked_bounds.max[i], instance_bounds.max[i] + 1e-4f);
+    }
+
+    // Rays hit the same surfaces as with the instance transforms
+    Scene instanced(instances);
+    Scene flattened({ Primitive(baked, material, std::make_shared<Transform>(), std::make_shared<Transform>()) });
+    int hits = 0;
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            Point target(bounds.min.x + (x + 0.5f) * (bounds.max.x - bounds.min.x) / 32,
+                bounds.min.y + (y + 0.5f) * (bounds.max.y - bounds.min.y) / 32, bounds.min.z);
+            Ray ray(Point(0.f, 0.f, 20.f), target - Point(0.f, 0.f, 20.f));
+            float t1 = Infinity, t2 = Infinity;
+            Intersection isec1, isec2;
+            bool hit = instanced.intersect(ray, t1, &isec1);
+            ASSERT_EQ(flattened.intersect(ray, t2, &isec2), hit) << "at " << x << "," << y;
+            if (hit) {
+                ++hits;
+                EXPECT_NEAR(t2, t1, 1e-4f);
+                SurfaceInteraction si1, si2;
+                instanced.compute_surface_interaction(ray, t1, isec1, si1);
+                flattened.compute_surface_interaction(ray, t2, isec2, si2);
+                expect_near(Vector(si2.p), Vector(si1.p), "point");
+                expect_near(Vector(si2.n), Vector(si1.n), "normal");
+            }
+        }
+    }
+    EXPECT_GT(hits, 100);
+}
+
+TEST(MeshTest, AnalyzeAccelerators) {
+    std::vector<Point> vertices;
+    auto mesh = height_field(vertices);
+    auto material = std::make_shared<MatteMaterial>(RGB(0.5f, 0.5f, 0.5f));
+    std::vector<Primitive> primitives;
+    for (auto &ltow : { instance_transform(), Transform::translate(-4.f, 1.f, 0.5f) }) {
+        primitives.push_back(Primitive(mesh, material, ltow, std::make_shared<Transform>(inverse(*ltow))));
+    }
+    Scene scene(primitives);
+    std::string metrics = scene.analyze_accelerators(100);
+    // The scene accelerator holds both instances, the shared mesh accelerator is listed once
+    std::string scene_key = "{\"scene\":{", geometries_key = "},\"geometries\":[{";
+    ASSERT_EQ(metrics.find(scene_key), 0u) << metrics;
+    size_t geometries = metrics.find(geometries_key);
+    ASSERT_NE(geometries, std::string::npos) << metrics;
+    EXPECT_EQ(metrics.find("\"geometries\":[", geometries + geometries_key.size()), std::string::npos) << metrics;
+    EXPECT_EQ(metrics.find("\"params\"", geometries + geometries_key.size()),
+        metrics.rfind("\"params\""));
+    std::string scene_metrics = metrics.substr(0, geometries), mesh_metrics = metrics.substr(geometries);
+    EXPECT_NE(scene_metrics.find("\"geometries\":2,"), std::string::npos) << scene_metrics;
+    EXPECT_NE(mesh_metrics.find("\"geometries\":8,"), std::string::npos) << mesh_metrics;
+    EXPECT_NE(mesh_metrics.find("\"rays\":100,"), std::string::npos) << mesh_metrics;
+    // Rays through the mesh bounds, from above and below the height field
+    size_t hit_rate = mesh_metrics.find("\"hit_rate\":");
+    ASSERT_NE(hit_rate, std::string::npos);
+    EXPECT_GT(std::atof(mesh_metrics.c_str() + hit_rate + 11), 0.5);
+}
@@ -0,0 +1,259 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "core/parser.h"
+
+using namespace gill::core;
+
+/**
+ * Averages the red channel of all pixels (with spectral rendering, pixels are only 1 on average).
+ */
+float mean_radiance(const Film &film) {
+    double sum = 0.0;
+    for (int y = 0; y < film._yres; ++y) {
+        for (int x = 0; x < film._xres; ++x) {
+            sum += film.get_radiance(x, y)[0];
+        }
+    }
+    return sum / (film._xres * film._yres);
+}
+
+/**
+ * Renders the inside of an emissive sphere (so that every sample carries a radiance of 1) onto a film
+ * smaller than the window of the parser's sampler (512x512 pixels).
+ */
+std::shared_ptr<Film> render_small_film(const std::string &filter, const std::string &filter_sampling,
+        int xres, int yres, int spp, const std::string &film_options = "") {
+    std::ostringstream yaml;
+    yaml << "scene:\n"
+        << "  primitives:\n"
+        << "    - geometry: !sphere { radius: 10.0 }\n"
+        << "      material: !emissive { color: [1.0, 1.0, 1.0] }\n"
+        << "      transform: !translate { delta: [0.0, 0.0, 0.0] }\n"
+        << "renderer: !sampled\n"
+        << "  camera: !perspective\n"
+        << "    transform: !look_at { position: [0.0, 0.0, -1.0], target: [0.0, 0.0, 0.0] }\n"
+        << "    field_of_view: 60.0\n"
+        << "    film:\n"
+        << "      resolution: [" << xres << ", " << yres << "]\n"
+        << "      filter: " << filter << "\n"
+        << "      filter_sampling: " << filter_sampling << "\n"
+        << film_options
+        << "  sampler: !stratified\n"
+        << "    samples_per_pixel: " << spp << "\n"
+        << "  surface_integrator: !path\n"
+        << "    max_depth: 1\n"
+        << "  thread_tiles: [4, 4]\n";
+    std::string filename = ::testing::TempDir() + "gill_small_film.yaml";
+    std::ofstream(filename) << yaml.str();
+    Parser parser(filename.c_str());
+    auto doc = parser.next_document();
+    doc->renderer->render(doc->scene.get());
+    return doc->renderer->camera()->_film;
+}
+
+TEST(SampledRendererTest, FilmSmallerThanSamplerWindow) {
+    const char *filters[] = { "!box { window: [1, 1] }", "!triangle { window: [2, 2] }",
+        "!gaussian { window: [2, 2], alpha: 2.0 }", "!mitchell { window: [2, 2], a: 0.33, b: 0.33 }" };
+    for (const char *filter : filters) {
+        for (const char *filter_sampling : { "splat", "importance" }) {
+            auto film = render_small_film(filter, filter_sampling, 40, 40, 1);
+            for (int y = 0; y < film->_yres; ++y) {
+                for (int x = 0; x < film->_xres; ++x) {
+                    RGB radiance = film->get_radiance(x, y);
+                    ASSERT_TRUE(std::isfinite(radiance[0])) << filter << " " << filter_sampling << " at " << x << "," << y;
+                    if (filter == filters[0]) {
+                        ASSERT_GT(radiance[0], 0.f) << filter_sampling << " at " << x << "," << y;
+                    }
+                    if (filter == filters[0] && std::string(filter_sampling) == "importance") {
+                        // Off-image samples are discarded, so each pixel receives exactly its own sample
+                        ASSERT_FLOAT_EQ(film->_pixels.at(x, y).weight, 1.f) << "at " << x << "," << y;
+                    }
+                }
+            }
+            if (filter == filters[0]) {
+                EXPECT_NEAR(mean_radiance(*film), 1.f, 0.02f) << filter_sampling;
+            }
+        }
+    }
+}
+
+TEST(SampledRendererTest, SmallFilmFeatures) {
+    for (const char *filter_sampling : { "splat", "importance" }) {
+        auto film = render_small_film("!gaussian { window: [2, 2], alpha: 2.0 }", filter_sampling, 40, 40, 4,
+            "      denoiser: !atrous { iterations: 2, threads: 1 }\n");
+        ASSERT_TRUE(film->has_features());
+        for (int i = 0; i < film->_xres * film->_yres; ++i) {
+            ASSERT_EQ(film->_features[i].samples, 4) << filter_sampling << " at " << i;
+            ASSERT_EQ(film->_features[i].hits, 4) << filter_sampling << " at " << i;
+        }
+    }
+}
+
+TEST(SampledRendererTest, Heatmap) {
+    auto film = render_small_film("!box { window: [1, 1] }", "importance", 8, 8, 4);
+    EXPECT_FALSE(film->has_heatmap());
+    // Same document, rendered with a heatmap
+    std::string filename = ::testing::TempDir() + "gill_small_film.yaml";
+    Parser parser(filename.c_str());
+    auto doc = parser.next_document();
+    film = doc->renderer->camera()->_film;
+    film->enable_heatmap();
+    doc->renderer->render(doc->scene.get());
+    ASSERT_TRUE(film->has_heatmap());
+    // Every sample visits the scene accelerator and tests the sphere, in all pixels alike
+    double cost = film->_cost[0].cost;
+    EXPECT_GE(cost, 4 * 2.0);
+    for (int i = 0; i < film->_xres * film->_yres; ++i) {
+        ASSERT_EQ(film->_cost[i].samples, 4) << "at " << i;
+        ASSERT_EQ(film->_cost[i].cost, cost) << "at " << i;
+    }
+
+    std::ostringstream ppm;
+    film->print_heatmap_ppm(ppm);
+    std::istringstream lines(ppm.str());
+    std::string magic, comment, size, max;
+    std::getline(lines, magic);
+    std::getline(lines, comment);
+    std::getline(lines, size);
+    std::getline(lines, max);
+    EXPECT_EQ(magic, "P3");
+    EXPECT_EQ(comment, "# traversal cost per sample, red = " + std::to_string((int)cost / 4));
+    EXPECT_EQ(size, "8 8");
+    EXPECT_EQ(max, "255");
+    // Uniform costs are at the top of the scale
+    int r, g, b, pixels = 0;
+    while (lines >> r >> g >> b) {
+        ASSERT_EQ(r, 255);
+        ASSERT_EQ(g, 0);
+        ASSERT_EQ(b, 0);
+        pixels++;
+    }
+    EXPECT_EQ(pixels, 8 * 8);
+}
+
+TEST(SampledRendererTest, MemoryUsage) {
+    render_small_film("!box { window: [1, 1] }", "splat", 40, 40, 1,
+        "      denoiser: !atrous { iterations: 2, threads: 1 }\n");
+    // Same document, not rendered
+    std::string filename = ::testing::TempDir() + "gill_small_film.yaml";
+    Parser parser(filename.c_str());
+    auto doc = parser.next_document();
+    auto film = doc->renderer->camera()->_film;
+    MemoryUsage film_usage, usage;
+    film->memory_usage(film_usage);
+    doc->renderer->memory_usage(usage);
+    // Each buffer of the film is counted once; those of the render tiles separately
+    EXPECT_EQ(usage.film_pixels, film_usage.film_pixels);
+    EXPECT_EQ(usage.film_tiles, film->_pixels.memory_usage() + 40 * 40 * sizeof(Film::FeaturePixel));
+}
+
+/**
+ * Renders a glass sphere inside an emissive sphere, so that the radiance of every path that leaves the glass is 1.
+ */
+std::shared_ptr<Film> render_glass_sphere(float dispersion) {
+    std::ostringstream yaml;
+    yaml << "scene:\n"
+        << "  primitives:\n"
+        << "    - geometry: !sphere { radius: 10.0 }\n"
+        << "      material: !emissive { color: [1.0, 1.0, 1.0] }\n"
+        << "      transform: !translate { delta: [0.0, 0.0, 0.0] }\n"
+        << "    - geometry: !sphere { radius: 0.5 }\n"
+        << "      material: !glass { color: [1.0, 1.0, 1.0], eta: 1.5, dispersion: " << dispersion << " }\n"
+        << "      transform: !translate { delta: [0.0, 0.0, 0.0] }\n"
+        << "renderer: !sampled\n"
+        << "  camera: !perspective\n"
+        << "    transform: !look_at { position: [0.0, 0.0, -1.5], target: [0.0, 0.0, 0.0] }\n"
+        << "    field_of_view: 60.0\n"
+        << "    film:\n"
+        << "      resolution: [32, 32]\n"
+        << "      filter: !box { window: [1, 1] }\n"
+        << "  sampler: !stratified\n"
+        << "    samples_per_pixel: 16\n"
+        << "  surface_integrator: !path\n"
+        << "    max_depth: 16\n"
+        << "  thread_tiles: [4, 4]\n";
+    std::string filename = ::testing::TempDir() + "gill_glass_sphere.yaml";
+    std::ofstream(filename) << yaml.str();
+    Parser parser(filename.c_str());
+    auto doc = parser.next_document();
+    doc->renderer->render(doc->scene.get());
+    return doc->renderer->camera()->_film;
+}
+
+TEST(SampledRendererTest, NegligibleDispersion) {
+    // With dispersion, the hero wavelength carries the contribution of the others once, however many times
+    // the path crosses the glass
+    float plain = mean_radiance(*render_glass_sphere(0.f));
+    float dispersive = mean_radiance(*render_glass_sphere(1e-6f));
+    EXPECT_NEAR(plain, 1.f, 0.05f);
+    EXPECT_NEAR(dispersive, plain, 0.05f);
+}
+
+/**
+ * Renders an emissive sphere on a 32x32 film in passes of 1 spp with a checkpoint, stopping after the two passes
+ * needed for a noise estimate.
+ * @returns Standard error output of the render.
+ */
+std::string render_checkpointed(const std::string &checkpoint, const std::string &color, int thread_tiles,
+        float target_noise, std::shared_ptr<Film> &film) {
+    std::ostringstream yaml;
+    yaml << "scene:\n"
+        << "  primitives:\n"
+        << "    - geometry: !sphere { radius: 10.0 }\n"
+        << "      material: !emissive { color: " << color << " }\n"
+        << "      transform: !translate { delta: [0.0, 0.0, 0.0] }\n"
+        << "renderer: !sampled\n"
+        << "  camera: !perspective\n"
+        << "    transform: !look_at { position: [0.0, 0.0, -1.0], target: [0.0, 0.0, 0.0] }\n"
+        << "    field_of_view: 60.0\n"
+        << "    film:\n"
+        << "      resolution: [32, 32]\n"
+        << "      filter: !box { window: [1, 1] }\n"
+        << "      filter_sampling: importance\n"
+        << "  sampler: !stratified\n"
+        << "    samples_per_pixel: 8\n"
+        << "  surface_integrator: !path\n"
+        << "    max_depth: 1\n"
+        << "  thread_tiles: [" << thread_tiles << ", " << thread_tiles << "]\n"
+        << "  progressive:\n"
+        << "    pass_spp: 1\n"
+        << "    target_noise: " << target_noise << "\n"
+        << "    checkpoint: " << checkpoint << "\n"
+        << "    checkpoint_interval: 0\n";
+    std::string filename = ::testing::TempDir() + "gill_checkpoint.yaml";
+    std::ofstream(filename) << yaml.str();
+    Parser parser(filename.c_str());
+    auto doc = parser.next_document();
+    ::testing::internal::CaptureStderr();
+    doc->renderer->render(doc->scene.get());
+    film = doc->renderer->camera()->_film;
+    return ::testing::internal::GetCapturedStderr();
+}
+
+TEST(SampledRendererTest, CheckpointMismatch) {
+    std::string checkpoint = ::testing::TempDir() + "gill_checkpoint.ckpt";
+    std::remove(checkpoint.c_str());
+    std::shared_ptr<Film> film;
+    std::string log = render_checkpointed(checkpoint, "[1.0, 1.0, 1.0]", 16, 0.5f, film);
+    EXPECT_NE(log.find("\"completed\":2,\"resumed\":0"), std::string::npos) << log;
+
+    // Another scene is rendered from scratch
+    log = render_checkpointed(checkpoint, "[0.5, 0.5, 0.5]", 16, 0.5f, film);
+    EXPECT_NE(log.find("of a different render"), std::string::npos);
+    EXPECT_NE(log.find("\"resumed\":0"), std::string::npos);
+    EXPECT_NEAR(mean_radiance(*film), 0.5f, 0.01f);
+
+    // As is the same scene with another tiling, whose passes would use other random numbers
+    log = render_checkpointed(checkpoint, "[0.5, 0.5, 0.5]", 8, 0.5f, film);
+    EXPECT_NE(log.find("of a different render"), std::string::npos);
+    EXPECT_NE(log.find("\"resumed\":0"), std::string::npos);
+
+    // Progressive settings may change between runs
+    log = render_checkpointed(checkpoint, "[0.5, 0.5, 0.5]", 8, 0.25f, film);
+    EXPECT_NE(log.find("\"resumed\":2"), std::string::npos);
+    EXPECT_NEAR(mean_radiance(*film), 0.5f, 0.01f);
+    std::remove(checkpoint.c_str());
+}